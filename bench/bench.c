@@ -0,0 +1,297 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "vm.h"
+#include "intern.h"
+
+#define DEFAULT_RUNS 10
+#define DEFAULT_THRESHOLD 5.0
+
+typedef struct {
+    char *name;
+    char *source;
+    int status;
+    double median;
+    double p99;
+    uint64_t instructions;
+    long peakRss;
+} Benchmark;
+
+typedef struct {
+    Benchmark *items;
+    int count;
+    int capacity;
+} BenchmarkList;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static char *readFile(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+    fseek(file, 0L, SEEK_END);
+    size_t fileSize = ftell(file);
+    rewind(file);
+    char *buffer = (char *) malloc(fileSize + 1);
+    if (buffer == NULL) exit(1);
+    size_t bytesRead = fread(buffer, sizeof(char), fileSize, file);
+    fclose(file);
+    buffer[bytesRead] = '\0';
+    return buffer;
+}
+
+static Benchmark *addBenchmark(BenchmarkList *list, const char *name, char *source) {
+    if (list->capacity < list->count + 1) {
+        list->capacity = list->capacity < 8 ? 8 : list->capacity * 2;
+        list->items = realloc(list->items, sizeof(Benchmark) * list->capacity);
+        if (list->items == NULL) exit(1);
+    }
+    Benchmark *benchmark = &list->items[list->count++];
+    memset(benchmark, 0, sizeof(Benchmark));
+    benchmark->name = strdup(name);
+    benchmark->source = source;
+    return benchmark;
+}
+
+// A large flat program, so the scanner, compiler and code emission dominate
+// rather than loops. A chunk holds at most 256 constants, so the generated
+// code sticks to locals, literals that need no constant, and control flow.
+static char *generateSource(int lines) {
+    char *buffer = NULL;
+    size_t size = 0;
+    FILE *out = open_memstream(&buffer, &size);
+    for (int i = 0; i < lines; i++) {
+        switch (i % 3) {
+            case 0:
+                fprintf(out, "{ let a = true; let b = !a; let c = a == b; if (c) a = b; else b = !c; }\n");
+                break;
+            case 1:
+                fprintf(out, "while (false) { let x = nil; x = !x; }\n");
+                break;
+            default:
+                fprintf(out, "{ let p = nil; { let q = !p; { let r = q == p; p = r; } } }\n");
+                break;
+        }
+    }
+    fclose(out);
+    return buffer;
+}
+
+static int runScript(const char *source, Profiler *profiler) {
+    VM vm;
+    initVM(&vm);
+    vm.out = fopen("/dev/null", "w");
+    vm.profiler = profiler;
+    InterpretResult result = interpret(&vm, source);
+    fclose(vm.out);
+    freeVM(&vm);
+    return result == COMPILE_ERROR ? 65 : result == OK ? 0 : 70;
+}
+
+// Each timed run happens in a fresh child so peak RSS is per run and one
+// script's heap never warms the allocator for the next.
+static bool timeRun(Benchmark *benchmark, double *seconds, long *rss) {
+    double start = now();
+    pid_t pid = fork();
+    if (pid < 0) return false;
+    if (pid == 0) _exit(runScript(benchmark->source, NULL));
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid) return false;
+    *seconds = now() - start;
+    *rss = usage.ru_maxrss;
+    benchmark->status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    return true;
+}
+
+static int compareDoubles(const void *a, const void *b) {
+    double da = *(const double *) a;
+    double db = *(const double *) b;
+    return (da > db) - (da < db);
+}
+
+static void measure(Benchmark *benchmark, int runs) {
+    // The instruction count comes from one profiled run in-process; the
+    // profiler's overhead would skew the timed runs.
+    Profiler profiler;
+    initProfiler(&profiler, benchmark->name);
+    benchmark->status = runScript(benchmark->source, &profiler);
+    for (int i = 0; i < UINT8_COUNT; i++) {
+        benchmark->instructions += profiler.ops[i].count;
+    }
+    freeProfiler(&profiler);
+    if (benchmark->status != 0) return;
+
+    double *times = malloc(sizeof(double) * runs);
+    if (times == NULL) exit(1);
+    for (int i = 0; i < runs; i++) {
+        long rss;
+        if (!timeRun(benchmark, &times[i], &rss)) {
+            benchmark->status = 71;
+            break;
+        }
+        if (benchmark->status != 0) break;
+        if (rss > benchmark->peakRss) benchmark->peakRss = rss;
+    }
+    if (benchmark->status == 0) {
+        qsort(times, runs, sizeof(double), compareDoubles);
+        benchmark->median = runs % 2 == 1 ? times[runs / 2]
+                                          : (times[runs / 2 - 1] + times[runs / 2]) / 2;
+        benchmark->p99 = times[(int) ceil(0.99 * runs) - 1];
+    }
+    free(times);
+}
+
+static bool writeResults(BenchmarkList *list, int runs, const char *path) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) return false;
+    fprintf(out, "{\n  \"runs\": %d,\n  \"benchmarks\": [\n", runs);
+    for (int i = 0; i < list->count; i++) {
+        Benchmark *benchmark = &list->items[i];
+        double ips = benchmark->median > 0 ? (double) benchmark->instructions / benchmark->median : 0;
+        fprintf(out, "    {\"name\": \"%s\", \"status\": %d, \"median_ms\": %.3f, \"p99_ms\": %.3f, "
+                     "\"instructions\": %llu, \"ips\": %.0f, \"peak_rss_kb\": %ld}%s\n",
+                benchmark->name, benchmark->status, benchmark->median * 1000, benchmark->p99 * 1000,
+                (unsigned long long) benchmark->instructions, ips, benchmark->peakRss,
+                i + 1 < list->count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+    return fclose(out) == 0;
+}
+
+// Reads back a file produced by writeResults. This is not a general JSON
+// parser: it relies on one benchmark object per line.
+static bool findBaseline(const char *baseline, const char *name, double *median, long *rss) {
+    char key[512];
+    snprintf(key, sizeof(key), "{\"name\": \"%s\",", name);
+    const char *line = strstr(baseline, key);
+    if (line == NULL) return false;
+    const char *field = strstr(line, "\"median_ms\": ");
+    const char *rssField = strstr(line, "\"peak_rss_kb\": ");
+    if (field == NULL || rssField == NULL) return false;
+    *median = strtod(field + 13, NULL) / 1000;
+    *rss = strtol(rssField + 15, NULL, 10);
+    return true;
+}
+
+static void printResults(BenchmarkList *list, const char *baseline, double threshold, int *regressions) {
+    printf("%-24s %10s %10s %14s %12s %s\n", "benchmark", "median ms", "p99 ms", "instr/s", "peak rss kb",
+           baseline != NULL ? "vs baseline" : "");
+    for (int i = 0; i < list->count; i++) {
+        Benchmark *benchmark = &list->items[i];
+        if (benchmark->status != 0) {
+            printf("%-24s failed with status %d\n", benchmark->name, benchmark->status);
+            (*regressions)++;
+            continue;
+        }
+        printf("%-24s %10.3f %10.3f %14.0f %12ld", benchmark->name, benchmark->median * 1000,
+               benchmark->p99 * 1000, (double) benchmark->instructions / benchmark->median,
+               benchmark->peakRss);
+
+        double baseMedian;
+        long baseRss;
+        if (baseline != NULL && findBaseline(baseline, benchmark->name, &baseMedian, &baseRss)) {
+            double timeDelta = (benchmark->median / baseMedian - 1) * 100;
+            double rssDelta = baseRss > 0 ? ((double) benchmark->peakRss / baseRss - 1) * 100 : 0;
+            printf(" %+6.1f%% time %+6.1f%% rss", timeDelta, rssDelta);
+            if (timeDelta > threshold || rssDelta > threshold) {
+                printf("  REGRESSION");
+                (*regressions)++;
+            }
+        } else if (baseline != NULL) {
+            printf(" (new)");
+        }
+        printf("\n");
+    }
+}
+
+static void usage() {
+    fprintf(stderr, "Usage: scripty-bench [-n runs] [-g generated-lines] [-o results.json]\n"
+                    "                     [--baseline=results.json] [--threshold=percent] script...\n");
+    exit(64);
+}
+
+int main(int argc, const char *argv[]) {
+    int runs = DEFAULT_RUNS;
+    int generatedLines = 0;
+    const char *outputPath = "bench.json";
+    const char *baselinePath = NULL;
+    double threshold = DEFAULT_THRESHOLD;
+    BenchmarkList list = {NULL, 0, 0};
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc) {
+            runs = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-g") == 0 && arg + 1 < argc) {
+            generatedLines = atoi(argv[++arg]);
+        } else if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc) {
+            outputPath = argv[++arg];
+        } else if (strncmp(argv[arg], "--baseline=", 11) == 0) {
+            baselinePath = argv[arg] + 11;
+        } else if (strncmp(argv[arg], "--threshold=", 12) == 0) {
+            threshold = atof(argv[arg] + 12);
+        } else if (argv[arg][0] == '-') {
+            usage();
+        } else {
+            char *source = readFile(argv[arg]);
+            if (source == NULL) {
+                fprintf(stderr, "Could not open file '%s'.\n", argv[arg]);
+                exit(74);
+            }
+            const char *name = strrchr(argv[arg], '/');
+            addBenchmark(&list, name != NULL ? name + 1 : argv[arg], source);
+        }
+    }
+    if (runs < 1) usage();
+    if (generatedLines > 0) {
+        char name[64];
+        snprintf(name, sizeof(name), "generated-%d", generatedLines);
+        addBenchmark(&list, name, generateSource(generatedLines));
+    }
+    if (list.count == 0) usage();
+
+    char *baseline = NULL;
+    if (baselinePath != NULL) {
+        baseline = readFile(baselinePath);
+        if (baseline == NULL) {
+            fprintf(stderr, "Could not open baseline '%s'.\n", baselinePath);
+            exit(74);
+        }
+    }
+
+    for (int i = 0; i < list.count; i++) {
+        measure(&list.items[i], runs);
+    }
+
+    int regressions = 0;
+    printResults(&list, baseline, threshold, &regressions);
+    if (!writeResults(&list, runs, outputPath)) {
+        fprintf(stderr, "Could not write results '%s'.\n", outputPath);
+        exit(74);
+    }
+    if (baseline != NULL) {
+        printf("%d regression%s beyond %.1f%%\n", regressions, regressions == 1 ? "" : "s", threshold);
+    }
+
+    for (int i = 0; i < list.count; i++) {
+        free(list.items[i].name);
+        free(list.items[i].source);
+    }
+    free(list.items);
+    free(baseline);
+    freeSharedStrings();
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,330 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vm.h"
+#include "chunk.h"
+#include "table.h"
+#include "object.h"
+#include "scanner.h"
+#include "intern.h"
+#include "profiler.h"
+#include "program.h"
+#include "columnar.h"
+#include "kernels.h"
+#include "native.h"
+
+// Tables grow 8x at a time, so every load factor below is measured at the
+// same 32768-slot capacity: 3072 keys is the most the previous size holds.
+#define TABLE_SLOTS 32768
+#define ROUNDS 7
+
+static volatile uint64_t sink;
+
+typedef struct {
+    VM vm;
+    ObjString **keys;
+    ObjString **missing;
+    int keyCount;
+} Bench;
+
+static void report(const char *name, long ops, uint64_t cycles) {
+    printf("%-40s %10ld %12.1f\n", name, ops, (double) cycles / (double) ops);
+}
+
+static ObjString **makeKeys(VM *vm, const char *prefix, int count) {
+    ObjString **keys = malloc(sizeof(ObjString *) * count);
+    if (keys == NULL) exit(1);
+    char buffer[32];
+    for (int i = 0; i < count; i++) {
+        int length = snprintf(buffer, sizeof(buffer), "%s%d", prefix, i);
+        keys[i] = copyString(vm, buffer, length);
+    }
+    return keys;
+}
+
+static void fillTable(Bench *bench, Table *table, int live, int tombstones) {
+    initTable(table);
+    for (int i = 0; i < live + tombstones; i++) {
+        tableSet(&bench->vm, table, bench->keys[i], NUM_VAL(i));
+    }
+    for (int i = live; i < live + tombstones; i++) {
+        tableDelete(table, bench->keys[i]);
+    }
+}
+
+// Runs `body` ROUNDS times and keeps the fastest round, which is the one
+// least disturbed by interrupts and frequency changes.
+#define MEASURE(name, ops, setup, body, teardown) \
+    do { \
+        uint64_t best = UINT64_MAX; \
+        for (int pass = 0; pass < ROUNDS; pass++) { \
+            setup; \
+            uint64_t start = readCycles(); \
+            body; \
+            uint64_t cycles = readCycles() - start; \
+            teardown; \
+            if (cycles < best) best = cycles; \
+        } \
+        report(name, ops, best); \
+    } while (false)
+
+static void benchLoadFactors(Bench *bench) {
+    static const double loads[] = {0.10, 0.25, 0.50, 0.70};
+    char name[64];
+    for (int l = 0; l < 4; l++) {
+        int live = (int) (loads[l] * TABLE_SLOTS);
+        Table table;
+        Value value;
+        fillTable(bench, &table, live, 0);
+
+        snprintf(name, sizeof(name), "tableGet hit      load %.2f", loads[l]);
+        MEASURE(name, live, , for (int i = 0; i < live; i++) sink += tableGet(&table, bench->keys[i], &value), );
+        snprintf(name, sizeof(name), "tableGet miss     load %.2f", loads[l]);
+        MEASURE(name, live, , for (int i = 0; i < live; i++) sink += tableGet(&table, bench->missing[i], &value), );
+        snprintf(name, sizeof(name), "tableSet update   load %.2f", loads[l]);
+        MEASURE(name, live, ,
+                for (int i = 0; i < live; i++) sink += tableSet(&bench->vm, &table, bench->keys[i], NUM_VAL(i)), );
+        freeTable(&bench->vm, &table);
+
+        snprintf(name, sizeof(name), "tableSet insert   to load %.2f", loads[l]);
+        MEASURE(name, live, initTable(&table),
+                for (int i = 0; i < live; i++) sink += tableSet(&bench->vm, &table, bench->keys[i], NUM_VAL(i)),
+                freeTable(&bench->vm, &table));
+        snprintf(name, sizeof(name), "tableDelete       load %.2f", loads[l]);
+        MEASURE(name, live, fillTable(bench, &table, live, 0),
+                for (int i = 0; i < live; i++) sink += tableDelete(&table, bench->keys[i]),
+                freeTable(&bench->vm, &table));
+    }
+}
+
+static void benchTombstones(Bench *bench) {
+    static const double ratios[] = {0.00, 0.25, 0.50, 0.75};
+    char name[64];
+    int occupied = TABLE_SLOTS / 2;
+    for (int r = 0; r < 4; r++) {
+        int tombstones = (int) (ratios[r] * occupied);
+        int live = occupied - tombstones;
+        Table table;
+        Value value;
+        fillTable(bench, &table, live, tombstones);
+
+        snprintf(name, sizeof(name), "tableGet hit      tombstones %.2f", ratios[r]);
+        MEASURE(name, live, , for (int i = 0; i < live; i++) sink += tableGet(&table, bench->keys[i], &value), );
+        snprintf(name, sizeof(name), "tableGet miss     tombstones %.2f", ratios[r]);
+        MEASURE(name, live, , for (int i = 0; i < live; i++) sink += tableGet(&table, bench->missing[i], &value), );
+        freeTable(&bench->vm, &table);
+    }
+}
+
+static void benchFindString(Bench *bench) {
+    int live = TABLE_SLOTS / 2;
+    Table table;
+    fillTable(bench, &table, live, 0);
+    MEASURE("tableFindString hit", live, ,
+            for (int i = 0; i < live; i++) {
+                ObjString *key = bench->keys[i];
+                sink += tableFindString(&table, key->chars, key->length, key->hash) != NULL;
+            }, );
+    MEASURE("tableFindString miss", live, ,
+            for (int i = 0; i < live; i++) {
+                ObjString *key = bench->missing[i];
+                sink += tableFindString(&table, key->chars, key->length, key->hash) != NULL;
+            }, );
+    freeTable(&bench->vm, &table);
+}
+
+// Writes a distinct 8-character prefix into each string so every round of a
+// "new" measurement interns strings nobody has seen yet.
+static void stampStrings(char *chars, int count, int stride, int round) {
+    for (int i = 0; i < count; i++) {
+        char *string = chars + (size_t) i * stride;
+        char saved = string[8];
+        // Clamped to fit; no measurement runs 100 rounds or 10^6 strings.
+        snprintf(string, 9, "%02d%06d", round % 100, i % 1000000);
+        string[8] = saved;
+    }
+}
+
+static void benchCopyString(Bench *bench) {
+    enum { COUNT = 20000, LONG = 256 };
+    char *chars = malloc((size_t) COUNT * LONG);
+    if (chars == NULL) exit(1);
+    memset(chars, 'x', (size_t) COUNT * LONG);
+
+    int round = 0;
+    MEASURE("copyString short (8) new", COUNT, stampStrings(chars, COUNT, LONG, round++),
+            for (int i = 0; i < COUNT; i++) sink += copyString(&bench->vm, chars + (size_t) i * LONG, 8)->length, );
+    MEASURE("copyString short (8) existing", COUNT, ,
+            for (int i = 0; i < COUNT; i++) sink += copyString(&bench->vm, chars + (size_t) i * LONG, 8)->length, );
+    MEASURE("copyString long (256) new", COUNT, stampStrings(chars, COUNT, LONG, round++),
+            for (int i = 0; i < COUNT; i++) sink += copyString(&bench->vm, chars + (size_t) i * LONG, LONG)->length, );
+    MEASURE("copyString long (256) existing", COUNT, ,
+            for (int i = 0; i < COUNT; i++) sink += copyString(&bench->vm, chars + (size_t) i * LONG, LONG)->length, );
+    free(chars);
+}
+
+static void benchWriteChunk(Bench *bench) {
+    enum { BYTES = 1 << 20 };
+    Chunk chunk;
+    MEASURE("writeChunk growth to 1MiB", BYTES, initChunk(&chunk),
+            for (int i = 0; i < BYTES; i++) writeChunk(&bench->vm, &chunk, (uint8_t) i, i >> 4),
+            freeChunk(&bench->vm, &chunk));
+}
+
+static void benchScanner() {
+    char *source = NULL;
+    size_t size = 0;
+    FILE *out = open_memstream(&source, &size);
+    for (int i = 0; i < 20000; i++) {
+        fprintf(out, "for (let i%d = 0; i%d < 10; i%d = i%d + 1) { puts \"line\" + \"%d\"; }\n", i, i, i, i, i);
+    }
+    fclose(out);
+
+    long tokens = 0;
+    Scanner scanner;
+    initScanner(&scanner, source);
+    while (scanToken(&scanner).type != T_EOF) tokens++;
+
+    MEASURE("scanToken", tokens, initScanner(&scanner, source),
+            for (Token token = scanToken(&scanner); token.type != T_EOF; token = scanToken(&scanner)) {
+                sink += token.length;
+            }, );
+    free(source);
+}
+
+static void benchEmbedding(Bench *bench) {
+    enum { ROWS = 100000 };
+    VM *vm = &bench->vm;
+    GlobalHandle inputs[2];
+    resolveGlobal(vm, &inputs[0], "x");
+    resolveGlobal(vm, &inputs[1], "y");
+    Value *rows = malloc(sizeof(Value) * ROWS * 2);
+    Value *results = malloc(sizeof(Value) * ROWS);
+    if (rows == NULL || results == NULL) exit(1);
+    for (int i = 0; i < ROWS; i++) {
+        rows[i * 2] = NUM_VAL(i);
+        rows[i * 2 + 1] = NUM_VAL(ROWS - i);
+    }
+
+    Program *program = compileProgram(vm, "x * 2 + y > 150000", true);
+    MEASURE("runProgramBatch x * 2 + y > 150000", ROWS, ,
+            runProgramBatch(vm, program, inputs, 2, rows, ROWS, results, NULL), );
+
+    Column columns[2];
+    double *xs = malloc(sizeof(double) * ROWS * 3);
+    if (xs == NULL) exit(1);
+    for (int i = 0; i < ROWS; i++) {
+        xs[i] = i;
+        xs[ROWS + i] = ROWS - i;
+    }
+    columns[0].global = inputs[0];
+    columns[0].values = xs;
+    columns[1].global = inputs[1];
+    columns[1].values = xs + ROWS;
+    MEASURE("runProgramColumns x * 2 + y > 150000", ROWS, ,
+            runProgramColumns(vm, program, columns, 2, ROWS, xs + 2 * ROWS), );
+    free(xs);
+    freeProgram(vm, program);
+
+    // The same work through interpret(), which recompiles every time.
+    enum { INTERPRETED = 2000 };
+    MEASURE("interpret x * 2 + y > 150000;", INTERPRETED, ,
+            for (int i = 0; i < INTERPRETED; i++) {
+                setGlobal(vm, &inputs[0], rows[i * 2]);
+                setGlobal(vm, &inputs[1], rows[i * 2 + 1]);
+                sink += interpret(vm, "x * 2 + y > 150000;");
+            }, );
+    free(rows);
+    free(results);
+}
+
+// A million doubles is 8MiB per operand, past most L2 caches, so these
+// report what the kernels sustain from memory.
+static void benchKernels() {
+    enum { COUNT = 1 << 20 };
+    double *a = malloc(sizeof(double) * COUNT * 3);
+    if (a == NULL) exit(1);
+    double *b = a + COUNT;
+    double *out = b + COUNT;
+    for (int i = 0; i < COUNT; i++) {
+        a[i] = i % 1000;
+        b[i] = (i % 7) * 0.5;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "sumFloat64 1M (%s)", kernelIsa());
+    MEASURE(name, COUNT, , sink += (uint64_t) sumFloat64(a, COUNT), );
+    snprintf(name, sizeof(name), "maxFloat64 1M (%s)", kernelIsa());
+    MEASURE(name, COUNT, , sink += (uint64_t) maxFloat64(a, COUNT), );
+    snprintf(name, sizeof(name), "dotFloat64 1M (%s)", kernelIsa());
+    MEASURE(name, COUNT, , sink += (uint64_t) dotFloat64(a, b, COUNT), );
+    snprintf(name, sizeof(name), "addFloat64 1M (%s)", kernelIsa());
+    MEASURE(name, COUNT, , addFloat64(out, a, b, COUNT); sink += (uint64_t) out[COUNT - 1], );
+    free(a);
+}
+
+// The same clamp as the standard fast-call native, through the generic
+// signature, to show what unboxed calls save.
+static bool genericClamp(VM *vm, int argCount, Value *args, Value *result) {
+    (void) argCount;
+    for (int i = 0; i < 3; i++) {
+        if (!IS_NUMERIC(args[i])) {
+            runtimeError(vm, "`gclamp` expects numbers.");
+            return false;
+        }
+    }
+    double x = asDouble(args[0]);
+    double low = asDouble(args[1]);
+    double high = asDouble(args[2]);
+    *result = NUM_VAL(x < low ? low : x > high ? high : x);
+    return true;
+}
+
+static void benchNatives(Bench *bench) {
+    enum { CALLS = 100000 };
+    VM *vm = &bench->vm;
+    defineNative(vm, "gclamp", 3, genericClamp);
+    interpret(vm, "fun sclamp(x, low, high) { if (x < low) return low; if (x > high) return high; return x; }");
+
+    static const char *callees[] = {"clamp", "gclamp", "sclamp"};
+    static const char *labels[] = {"fast-call native", "generic native", "script function"};
+    char source[160];
+    char name[64];
+    for (int c = 0; c < 3; c++) {
+        snprintf(source, sizeof(source),
+                 "let s = 0; for (let i = 0; i < %d; i = i + 1) s = s + %s(i, 10, 20);", CALLS, callees[c]);
+        Program *program = compileProgram(vm, source, false);
+        snprintf(name, sizeof(name), "call clamp(i, 10, 20) %s", labels[c]);
+        MEASURE(name, CALLS, , runProgram(vm, program, NULL), );
+        freeProgram(vm, program);
+    }
+}
+
+int main() {
+    Bench bench;
+    initVM(&bench.vm);
+    bench.keyCount = TABLE_SLOTS;
+    bench.keys = makeKeys(&bench.vm, "key", bench.keyCount);
+    bench.missing = makeKeys(&bench.vm, "absent", bench.keyCount);
+
+    printf("%-40s %10s %12s\n", "operation", "ops", "cycles/op");
+    benchLoadFactors(&bench);
+    benchTombstones(&bench);
+    benchFindString(&bench);
+    benchCopyString(&bench);
+    benchWriteChunk(&bench);
+    benchScanner();
+    benchEmbedding(&bench);
+    benchKernels();
+    benchNatives(&bench);
+
+    free(bench.keys);
+    free(bench.missing);
+    freeVM(&bench.vm);
+    freeSharedStrings();
+    return 0;
+}
@@ -0,0 +1,346 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "batch.h"
+#include "scheduler.h"
+#include "vm.h"
+
+typedef struct Batch Batch;
+
+typedef struct {
+    Batch *batch;
+    char *path;
+    char *output;
+    size_t outputSize;
+    char *errors;
+    size_t errorsSize;
+    int status;
+    double seconds;
+    bool done;
+    // Only used while the job runs on the scheduler.
+    FILE *out;
+    FILE *err;
+    double start;
+} Job;
+
+// Job indices owned by one worker. The owner takes from the head and idle
+// workers steal from the tail, so long scripts never strand the rest of a
+// worker's share.
+typedef struct {
+    pthread_mutex_t lock;
+    int *jobs;
+    int head;
+    int tail;
+} JobQueue;
+
+typedef struct {
+    Batch *batch;
+    pthread_t thread;
+    JobQueue queue;
+    VM vm;
+} Worker;
+
+struct Batch {
+    Job *jobs;
+    int jobCount;
+    int jobCapacity;
+    Worker *workers;
+    int workerCount;
+    pthread_mutex_t doneLock;
+    pthread_cond_t doneCond;
+};
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static void addJob(Batch *batch, const char *path, size_t length) {
+    if (batch->jobCapacity < batch->jobCount + 1) {
+        batch->jobCapacity = batch->jobCapacity < 8 ? 8 : batch->jobCapacity * 2;
+        batch->jobs = realloc(batch->jobs, sizeof(Job) * batch->jobCapacity);
+        if (batch->jobs == NULL) exit(1);
+    }
+    Job *job = &batch->jobs[batch->jobCount++];
+    memset(job, 0, sizeof(Job));
+    job->batch = batch;
+    job->path = strndup(path, length);
+}
+
+static bool addManifest(Batch *batch, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open manifest '%s'.\n", path);
+        return false;
+    }
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t length;
+    while ((length = getline(&line, &capacity, file)) != -1) {
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r' ||
+                              line[length - 1] == ' ' || line[length - 1] == '\t')) {
+            length--;
+        }
+        if (length == 0 || line[0] == '#') continue;
+        addJob(batch, line, (size_t) length);
+    }
+    free(line);
+    fclose(file);
+    return true;
+}
+
+static char *readScript(const char *path, FILE *err) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(err, "Could not open file '%s'.\n", path);
+        return NULL;
+    }
+    fseek(file, 0L, SEEK_END);
+    size_t fileSize = ftell(file);
+    rewind(file);
+    char *buffer = (char *) malloc(fileSize + 1);
+    if (buffer == NULL) {
+        fprintf(err, "Not enough memory to read '%s'.\n", path);
+        fclose(file);
+        return NULL;
+    }
+    size_t bytesRead = fread(buffer, sizeof(char), fileSize, file);
+    fclose(file);
+    if (bytesRead < fileSize) {
+        fprintf(err, "Could not read file '%s'.\n", path);
+        free(buffer);
+        return NULL;
+    }
+    buffer[bytesRead] = '\0';
+    return buffer;
+}
+
+static void completeJob(Job *job) {
+    Batch *batch = job->batch;
+    pthread_mutex_lock(&batch->doneLock);
+    job->done = true;
+    pthread_cond_broadcast(&batch->doneCond);
+    pthread_mutex_unlock(&batch->doneLock);
+}
+
+static int exitStatus(InterpretResult result) {
+    return result == COMPILE_ERROR ? 65 : result == OK ? 0 : 70;
+}
+
+static void runJob(Worker *worker, Job *job) {
+    FILE *out = open_memstream(&job->output, &job->outputSize);
+    FILE *err = open_memstream(&job->errors, &job->errorsSize);
+    double start = now();
+
+    char *source = readScript(job->path, err);
+    if (source == NULL) {
+        job->status = 74;
+    } else {
+        VM *vm = &worker->vm;
+        initVM(vm);
+        vm->out = out;
+        vm->err = err;
+        InterpretResult result = interpret(vm, source);
+        freeVM(vm);
+        free(source);
+        job->status = exitStatus(result);
+    }
+
+    job->seconds = now() - start;
+    fclose(out);
+    fclose(err);
+    completeJob(job);
+}
+
+static bool takeJob(JobQueue *queue, bool fromTail, int *job) {
+    bool found = false;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->head < queue->tail) {
+        *job = fromTail ? queue->jobs[--queue->tail] : queue->jobs[queue->head++];
+        found = true;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+static bool nextJob(Worker *worker, int *job) {
+    if (takeJob(&worker->queue, false, job)) return true;
+
+    Batch *batch = worker->batch;
+    int self = (int) (worker - batch->workers);
+    for (int i = 1; i < batch->workerCount; i++) {
+        Worker *victim = &batch->workers[(self + i) % batch->workerCount];
+        if (takeJob(&victim->queue, true, job)) return true;
+    }
+    return false;
+}
+
+static void *workerMain(void *arg) {
+    Worker *worker = (Worker *) arg;
+    int job;
+    while (nextJob(worker, &job)) {
+        runJob(worker, &worker->batch->jobs[job]);
+    }
+    return NULL;
+}
+
+static void startWorkers(Batch *batch) {
+    // Deal jobs round-robin so every worker starts near the front of the
+    // list and output can be flushed in order as early as possible.
+    int workers = batch->workerCount;
+    batch->workers = calloc(workers, sizeof(Worker));
+    if (batch->workers == NULL) exit(1);
+    for (int w = 0; w < workers; w++) {
+        Worker *worker = &batch->workers[w];
+        worker->batch = batch;
+        pthread_mutex_init(&worker->queue.lock, NULL);
+        worker->queue.jobs = malloc(sizeof(int) * (batch->jobCount / workers + 1));
+        if (worker->queue.jobs == NULL) exit(1);
+        for (int job = w; job < batch->jobCount; job += workers) {
+            worker->queue.jobs[worker->queue.tail++] = job;
+        }
+    }
+    for (int w = 0; w < workers; w++) {
+        pthread_create(&batch->workers[w].thread, NULL, workerMain, &batch->workers[w]);
+    }
+}
+
+static void stopWorkers(Batch *batch) {
+    for (int w = 0; w < batch->workerCount; w++) {
+        pthread_join(batch->workers[w].thread, NULL);
+    }
+    for (int w = 0; w < batch->workerCount; w++) {
+        pthread_mutex_destroy(&batch->workers[w].queue.lock);
+        free(batch->workers[w].queue.jobs);
+    }
+    free(batch->workers);
+}
+
+static void scheduledDone(void *data, InterpretResult result) {
+    Job *job = (Job *) data;
+    job->status = exitStatus(result);
+    job->seconds = now() - job->start;
+    fclose(job->out);
+    fclose(job->err);
+    completeJob(job);
+}
+
+// Time-sliced mode: every script is in flight at once and the workers
+// round-robin between them, so a long script cannot hold up short ones.
+static Scheduler *startScheduled(Batch *batch, uint64_t slice) {
+    Scheduler *scheduler = startScheduler(batch->workerCount, slice);
+    for (int i = 0; i < batch->jobCount; i++) {
+        Job *job = &batch->jobs[i];
+        job->out = open_memstream(&job->output, &job->outputSize);
+        job->err = open_memstream(&job->errors, &job->errorsSize);
+        job->start = now();
+        char *source = readScript(job->path, job->err);
+        if (source == NULL) {
+            job->status = 74;
+            fclose(job->out);
+            fclose(job->err);
+            completeJob(job);
+            continue;
+        }
+        spawnTask(scheduler, source, job->out, job->err, scheduledDone, job);
+        free(source);
+    }
+    return scheduler;
+}
+
+static void report(Batch *batch, double wall) {
+    int ok = 0, compileErrors = 0, runtimeErrors = 0, unreadable = 0;
+    double total = 0;
+    Job *slowest = NULL;
+    for (int i = 0; i < batch->jobCount; i++) {
+        Job *job = &batch->jobs[i];
+        switch (job->status) {
+            case 0:
+                ok++;
+                break;
+            case 65:
+                compileErrors++;
+                break;
+            case 70:
+                runtimeErrors++;
+                break;
+            default:
+                unreadable++;
+                break;
+        }
+        total += job->seconds;
+        if (slowest == NULL || job->seconds > slowest->seconds) slowest = job;
+    }
+
+    fprintf(stderr, "batch: %d scripts on %d workers in %.3fs (%.3fs of script time, %.3fms mean)\n",
+            batch->jobCount, batch->workerCount, wall, total, total * 1000 / batch->jobCount);
+    fprintf(stderr, "batch: %d ok, %d compile errors, %d runtime errors, %d unreadable\n",
+            ok, compileErrors, runtimeErrors, unreadable);
+    fprintf(stderr, "batch: slowest '%s' (%.3fs)\n", slowest->path, slowest->seconds);
+}
+
+int runBatch(int count, const char *paths[], int workers, uint64_t slice) {
+    Batch batch;
+    memset(&batch, 0, sizeof(Batch));
+    for (int i = 0; i < count; i++) {
+        if (paths[i][0] == '@') {
+            if (!addManifest(&batch, paths[i] + 1)) return 74;
+        } else {
+            addJob(&batch, paths[i], strlen(paths[i]));
+        }
+    }
+    if (batch.jobCount == 0) return 0;
+
+    if (workers < 1) workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers < 1) workers = 1;
+    if (workers > batch.jobCount) workers = batch.jobCount;
+    batch.workerCount = workers;
+    pthread_mutex_init(&batch.doneLock, NULL);
+    pthread_cond_init(&batch.doneCond, NULL);
+
+    double start = now();
+    Scheduler *scheduler = NULL;
+    if (slice > 0) {
+        scheduler = startScheduled(&batch, slice);
+    } else {
+        startWorkers(&batch);
+    }
+
+    int status = 0;
+    for (int i = 0; i < batch.jobCount; i++) {
+        Job *job = &batch.jobs[i];
+        pthread_mutex_lock(&batch.doneLock);
+        while (!job->done) pthread_cond_wait(&batch.doneCond, &batch.doneLock);
+        pthread_mutex_unlock(&batch.doneLock);
+
+        fwrite(job->output, 1, job->outputSize, stdout);
+        fwrite(job->errors, 1, job->errorsSize, stderr);
+        free(job->output);
+        free(job->errors);
+        if (job->status > status) status = job->status;
+    }
+    fflush(stdout);
+
+    if (scheduler != NULL) {
+        stopScheduler(scheduler);
+    } else {
+        stopWorkers(&batch);
+    }
+    report(&batch, now() - start);
+
+    for (int i = 0; i < batch.jobCount; i++) {
+        free(batch.jobs[i].path);
+    }
+    free(batch.jobs);
+    pthread_cond_destroy(&batch.doneCond);
+    pthread_mutex_destroy(&batch.doneLock);
+    return status;
+}
@@ -0,0 +1,18 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#ifndef CSCRIPTY_BATCH_H
+#define CSCRIPTY_BATCH_H
+
+#include "common.h"
+
+// Runs every script named in `paths` on a pool of `workers` threads, one VM
+// per thread. An argument of the form `@file` is a manifest listing one
+// script path per line. Script output is emitted in argument order and a
+// timing summary is written to stderr. With a non-zero `slice`, scripts are
+// time-sliced on a scheduler instead, each running at most `slice`
+// back-edges and calls before yielding to the next. Returns the process exit status.
+int runBatch(int count, const char *paths[], int workers, uint64_t slice);
+
+#endif //CSCRIPTY_BATCH_H
@@ -10,29 +10,29 @@ void initChunk(Chunk *chunk) {
     chunk->count = 0;
     chunk->code = NULL;
     chunk->lines = NULL;
-    initValueArray(&chunk->constants);
+    initValueArray(&chunk->constants, MEM_CONSTANTS);
 }
 
-void writeChunk(Chunk *chunk, uint8_t byte, int line) {
+void writeChunk(VM *vm, Chunk *chunk, uint8_t byte, int line) {
     if (chunk->capacity < chunk->count + 1) {
         int oldCap = chunk->capacity;
         chunk->capacity = GROW_CAPACITY(oldCap);
-        chunk->code = GROW_ARRAY(uint8_t, chunk->code, oldCap, chunk->capacity);
-        chunk->lines = GROW_ARRAY(int, chunk->lines, oldCap, chunk->capacity);
+        chunk->code = GROW_ARRAY(vm, MEM_CODE, uint8_t, chunk->code, oldCap, chunk->capacity);
+        chunk->lines = GROW_ARRAY(vm, MEM_LINES, int, chunk->lines, oldCap, chunk->capacity);
     }
     chunk->lines[chunk->count] = line;
     chunk->code[chunk->count] = byte;
     chunk->count++;
 }
 
-void freeChunk(Chunk *chunk) {
-    FREE_ARRAY(uint8_t, chunk->code, chunk->capacity);
-    FREE_ARRAY(int, chunk->lines, chunk->capacity);
-    freeValueArray(&chunk->constants);
+void freeChunk(VM *vm, Chunk *chunk) {
+    FREE_ARRAY(vm, MEM_CODE, uint8_t, chunk->code, chunk->capacity);
+    FREE_ARRAY(vm, MEM_LINES, int, chunk->lines, chunk->capacity);
+    freeValueArray(vm, &chunk->constants);
     initChunk(chunk);
 }
 
-int addConstant(Chunk *chunk, Value value) {
-    writeValueArray(&chunk->constants, value);
+int addConstant(VM *vm, Chunk *chunk, Value value) {
+    writeValueArray(vm, &chunk->constants, value);
     return chunk->constants.count - 1;
 }
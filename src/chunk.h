@@ -32,6 +32,37 @@ typedef enum {
     OP_JUMP,
     OP_JUMP_IF_FALSE,
     OP_LOOP,
+    OP_BUILD_LIST,
+    OP_INDEX_GET,
+    OP_INDEX_SET,
+    OP_LENGTH,
+    OP_APPEND,
+    OP_BUILD_MAP,
+    OP_HAS,
+    OP_REMOVE,
+    OP_FLOAT64,
+    OP_SUM,
+    OP_MIN,
+    OP_MAX,
+    OP_DOT,
+    OP_SCALE,
+    OP_ARRAY_ADD,
+    OP_ARRAY_MUL,
+    OP_CALL,
+    OP_TAIL_CALL,
+    // Arithmetic on operands the compiler proved numeric, without the type
+    // guards of the plain opcodes.
+    OP_ADD_NN,
+    OP_SUB_NN,
+    OP_MUL_NN,
+    OP_DIV_NN,
+    OP_LESS_NN,
+    OP_GREATER_NN,
+    OP_NEGATE_NN,
+    // A call whose arguments the compiler proved numeric. Fast natives of
+    // the same arity take them without checks; any other callee is called
+    // as by OP_CALL.
+    OP_CALL_NN,
     OP_RETURN
 } OpCode;
 
@@ -45,10 +76,10 @@ typedef struct {
 
 void initChunk(Chunk *chunk);
 
-void freeChunk(Chunk *chunk);
+void freeChunk(VM *vm, Chunk *chunk);
 
-void writeChunk(Chunk *chunk, uint8_t byte, int line);
+void writeChunk(VM *vm, Chunk *chunk, uint8_t byte, int line);
 
-int addConstant(Chunk *chunk, Value value);
+int addConstant(VM *vm, Chunk *chunk, Value value);
 
 #endif //CSCRIPTY_CHUNK_H
@@ -0,0 +1,273 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "columnar.h"
+#include "chunk.h"
+#include "memory.h"
+#include "object.h"
+
+typedef enum {
+    K_NUM,
+    K_BOOL
+} Kind;
+
+// One decoded instruction. `column` is the bound column a global reads, or
+// -1 when the global is a number held in vm->globals and read as `scalar`.
+typedef struct {
+    uint8_t op;
+    int column;
+    double scalar;
+} Step;
+
+typedef struct {
+    Step *steps;
+    int count;
+    int depth;
+    Kind result;
+} Plan;
+
+// A stack slot while a block runs: a single value for every row, or a
+// pointer to one value per row.
+typedef struct {
+    const double *data;
+    double scalar;
+    bool isScalar;
+} Operand;
+
+static bool pushKind(Kind *kinds, int *depth, Kind kind) {
+    if (*depth == STACK_MAX) return false;
+    kinds[(*depth)++] = kind;
+    return true;
+}
+
+// The block loop only needs the operation, and checks operand kinds for
+// itself, so the compiler's unchecked forms plan like the plain opcodes.
+static uint8_t plainOp(uint8_t op) {
+    switch (op) {
+        case OP_ADD_NN: return OP_ADD;
+        case OP_SUB_NN: return OP_SUB;
+        case OP_MUL_NN: return OP_MUL;
+        case OP_DIV_NN: return OP_DIV;
+        case OP_LESS_NN: return OP_LESS;
+        case OP_GREATER_NN: return OP_GREATER;
+        case OP_NEGATE_NN: return OP_NEGATE;
+        default: return op;
+    }
+}
+
+// Decodes the chunk and checks every operand type up front, so running a
+// block needs no type checks. Returns false for any chunk the block loop
+// cannot run exactly as run() would.
+static bool makePlan(VM *vm, Chunk *chunk, Column *columns, int columnCount, Plan *plan) {
+    Kind kinds[STACK_MAX];
+    int depth = 0;
+    plan->steps = malloc(sizeof(Step) * chunk->count);
+    if (plan->steps == NULL) exit(1);
+    plan->count = 0;
+    plan->depth = 0;
+
+    for (int offset = 0; offset < chunk->count;) {
+        Step *step = &plan->steps[plan->count++];
+        step->op = plainOp(chunk->code[offset]);
+        step->column = -1;
+        switch (step->op) {
+            case OP_CONSTANT: {
+                Value constant = chunk->constants.values[chunk->code[offset + 1]];
+                if (!IS_NUMERIC(constant)) return false;
+                step->scalar = asDouble(constant);
+                if (!pushKind(kinds, &depth, K_NUM)) return false;
+                offset += 2;
+                break;
+            }
+            case OP_TRUE:
+            case OP_FALSE:
+                step->scalar = step->op == OP_TRUE;
+                if (!pushKind(kinds, &depth, K_BOOL)) return false;
+                offset++;
+                break;
+            case OP_GET_GLOBAL: {
+                ObjString *name = AS_STRING(chunk->constants.values[chunk->code[offset + 1]]);
+                for (int i = 0; i < columnCount; i++) {
+                    if (columns[i].global.name == name) step->column = i;
+                }
+                if (step->column == -1) {
+                    Value value;
+                    if (!tableGet(&vm->globals, name, &value) || !IS_NUMERIC(value)) return false;
+                    step->scalar = asDouble(value);
+                }
+                if (!pushKind(kinds, &depth, K_NUM)) return false;
+                offset += 2;
+                break;
+            }
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:
+            case OP_GREATER:
+            case OP_LESS:
+                if (depth < 2 || kinds[depth - 1] != K_NUM || kinds[depth - 2] != K_NUM) return false;
+                depth--;
+                kinds[depth - 1] = step->op == OP_GREATER || step->op == OP_LESS ? K_BOOL : K_NUM;
+                offset++;
+                break;
+            case OP_EQUAL:
+                if (depth < 2 || kinds[depth - 1] != kinds[depth - 2]) return false;
+                depth--;
+                kinds[depth - 1] = K_BOOL;
+                offset++;
+                break;
+            case OP_NEGATE:
+            case OP_NOT:
+                if (depth < 1 || kinds[depth - 1] != (step->op == OP_NEGATE ? K_NUM : K_BOOL)) return false;
+                offset++;
+                break;
+            case OP_RETURN:
+                plan->count--;
+                if (depth != 1) return false;
+                plan->result = kinds[0];
+                return true;
+            default:
+                return false;
+        }
+        if (depth > plan->depth) plan->depth = depth;
+    }
+    return false;
+}
+
+#define VECTOR_LOOP(expr) \
+    do { \
+        if (a->isScalar) { \
+            double x = a->scalar; \
+            for (int i = 0; i < n; i++) { double y = b->data[i]; r[i] = (expr); } \
+        } else if (b->isScalar) { \
+            double y = b->scalar; \
+            for (int i = 0; i < n; i++) { double x = a->data[i]; r[i] = (expr); } \
+        } else { \
+            for (int i = 0; i < n; i++) { double x = a->data[i]; double y = b->data[i]; r[i] = (expr); } \
+        } \
+    } while (false)
+
+static double scalarBinary(uint8_t op, double x, double y) {
+    switch (op) {
+        case OP_ADD: return x + y;
+        case OP_SUB: return x - y;
+        case OP_MUL: return x * y;
+        case OP_DIV: return x / y;
+        case OP_GREATER: return x > y;
+        case OP_LESS: return x < y;
+        default: return x == y;
+    }
+}
+
+static void binary(uint8_t op, Operand *a, const Operand *b, double *r, int n) {
+    if (a->isScalar && b->isScalar) {
+        a->scalar = scalarBinary(op, a->scalar, b->scalar);
+        return;
+    }
+    switch (op) {
+        case OP_ADD: VECTOR_LOOP(x + y); break;
+        case OP_SUB: VECTOR_LOOP(x - y); break;
+        case OP_MUL: VECTOR_LOOP(x * y); break;
+        case OP_DIV: VECTOR_LOOP(x / y); break;
+        case OP_GREATER: VECTOR_LOOP(x > y); break;
+        case OP_LESS: VECTOR_LOOP(x < y); break;
+        default: VECTOR_LOOP(x == y); break;
+    }
+    a->data = r;
+    a->isScalar = false;
+}
+
+static void unary(uint8_t op, Operand *a, double *r, int n) {
+    if (a->isScalar) {
+        a->scalar = op == OP_NEGATE ? -a->scalar : 1 - a->scalar;
+        return;
+    }
+    if (op == OP_NEGATE) {
+        for (int i = 0; i < n; i++) r[i] = -a->data[i];
+    } else {
+        for (int i = 0; i < n; i++) r[i] = 1 - a->data[i];
+    }
+    a->data = r;
+    a->isScalar = false;
+}
+
+static void runBlocks(Plan *plan, Column *columns, int rowCount, double *results) {
+    // Slot k of the stack writes into buffers[k], so an operation can
+    // overwrite its left operand in place.
+    double *buffers = malloc(sizeof(double) * COLUMN_BLOCK * plan->depth);
+    Operand *stack = malloc(sizeof(Operand) * plan->depth);
+    if (buffers == NULL || stack == NULL) exit(1);
+
+    for (int base = 0; base < rowCount; base += COLUMN_BLOCK) {
+        int n = rowCount - base < COLUMN_BLOCK ? rowCount - base : COLUMN_BLOCK;
+        int depth = 0;
+        for (int s = 0; s < plan->count; s++) {
+            Step *step = &plan->steps[s];
+            switch (step->op) {
+                case OP_CONSTANT:
+                case OP_TRUE:
+                case OP_FALSE:
+                case OP_GET_GLOBAL: {
+                    Operand *operand = &stack[depth++];
+                    operand->isScalar = step->column == -1;
+                    operand->scalar = step->scalar;
+                    if (!operand->isScalar) operand->data = columns[step->column].values + base;
+                    break;
+                }
+                case OP_NEGATE:
+                case OP_NOT:
+                    unary(step->op, &stack[depth - 1], buffers + (size_t) (depth - 1) * COLUMN_BLOCK, n);
+                    break;
+                default:
+                    depth--;
+                    binary(step->op, &stack[depth - 1], &stack[depth],
+                           buffers + (size_t) (depth - 1) * COLUMN_BLOCK, n);
+                    break;
+            }
+        }
+        if (stack[0].isScalar) {
+            for (int i = 0; i < n; i++) results[base + i] = stack[0].scalar;
+        } else {
+            memcpy(results + base, stack[0].data, sizeof(double) * n);
+        }
+    }
+    free(buffers);
+    free(stack);
+}
+
+static InterpretResult runRows(VM *vm, Program *program, Column *columns, int columnCount,
+                               int rowCount, double *results) {
+    for (int row = 0; row < rowCount; row++) {
+        for (int i = 0; i < columnCount; i++) {
+            setGlobal(vm, &columns[i].global, NUM_VAL(columns[i].values[row]));
+        }
+        Value value;
+        InterpretResult status = runProgram(vm, program, &value);
+        if (status != OK) return status;
+        if (IS_NUMERIC(value)) {
+            results[row] = asDouble(value);
+        } else if (IS_BOOL(value)) {
+            results[row] = AS_BOOL(value);
+        } else {
+            fprintf(vm->err, "Row %d: a column result must be a number or a boolean.\n", row);
+            return RUNTIME_ERROR;
+        }
+    }
+    return OK;
+}
+
+InterpretResult runProgramColumns(VM *vm, Program *program, Column *columns, int columnCount,
+                                  int rowCount, double *results) {
+    if (!program->expression) {
+        fprintf(vm->err, "Only expression programs can be evaluated over columns.\n");
+        return RUNTIME_ERROR;
+    }
+    Plan plan;
+    bool vectorizable = makePlan(vm, &program->context->chunk, columns, columnCount, &plan);
+    if (vectorizable) runBlocks(&plan, columns, rowCount, results);
+    free(plan.steps);
+    return vectorizable ? OK : runRows(vm, program, columns, columnCount, rowCount, results);
+}
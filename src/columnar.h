@@ -0,0 +1,27 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#ifndef CSCRIPTY_COLUMNAR_H
+#define CSCRIPTY_COLUMNAR_H
+
+#include "common.h"
+#include "program.h"
+
+#define COLUMN_BLOCK 1024
+
+// Binds a global to one value per row.
+typedef struct {
+    GlobalHandle global;
+    const double *values;
+} Column;
+
+// Evaluates an expression program once per row and writes the results to
+// `results`, with booleans stored as 1 and 0. Straight-line numeric
+// expressions run an opcode at a time over blocks of COLUMN_BLOCK rows;
+// anything else falls back to one runProgram() per row. Integer constants
+// and globals are widened to double, like the columns themselves.
+InterpretResult runProgramColumns(VM *vm, Program *program, Column *columns, int columnCount,
+                                  int rowCount, double *results);
+
+#endif //CSCRIPTY_COLUMNAR_H
@@ -9,8 +9,27 @@
 #include <stddef.h>
 #include <stdint.h>
 
-#define DEBUG_PRINT_CODE
-#define DEBUG_TRACE_EXECUTION
+// Define to dump the bytecode of every compiled chunk.
+//#define DEBUG_PRINT_CODE
+// Define to check, as they run, the operand types the compiler proved for
+// unchecked opcodes. Debug builds define it.
+//#define DEBUG_ASSERT_TYPES
 #define UINT8_COUNT (UINT8_MAX + 1)
 
+typedef struct VM VM;
+
+// What a block handed out by reallocate() is used for.
+typedef enum {
+    MEM_STRING,
+    MEM_CODE,
+    MEM_LINES,
+    MEM_CONSTANTS,
+    MEM_TABLE,
+    MEM_STACK,
+    MEM_LIST,
+    MEM_MAP,
+    MEM_ARRAY,
+    MEM_CATEGORY_COUNT
+} MemCategory;
+
 #endif //CSCRIPTY_COMMON_H
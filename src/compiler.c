@@ -5,10 +5,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include "common.h"
 #include "compiler.h"
 #include "scanner.h"
 #include "object.h"
+#include "ir.h"
+#include "optimizer.h"
 
 #ifdef DEBUG_PRINT_CODE
 
@@ -16,12 +19,6 @@
 
 #endif
 
-typedef struct {
-    Token current;
-    Token previous;
-    bool hadError;
-    bool panicMode;
-} Parser;
 
 typedef enum {
     NONE,
@@ -37,179 +34,545 @@ typedef enum {
     PRIMARY
 } Precedence;
 
-typedef void (*ParseFn)(bool canAssign);
-
-typedef struct {
-    ParseFn prefix;
-    ParseFn infix;
-    Precedence precedence;
-} ParseRule;
-
 typedef struct {
     Token name;
     int depth;
+    // The local's variable in the tree being built.
+    int var;
 } Local;
 
-typedef struct {
+// One per function being compiled, innermost first. The script itself has
+// no function and compiles into the parser's chunk.
+typedef struct Compiler {
+    struct Compiler *enclosing;
+    ObjFunction *function;
+    Chunk *chunk;
+    // The tree of the function, or of the top-level declaration being
+    // compiled.
+    Ir *ir;
     Local locals[UINT8_COUNT];
     int localCount;
     int scopeDepth;
+    // Stack slots in use by locals while the tree is emitted.
+    int slotCount;
 } Compiler;
 
-Parser parser;
+typedef struct {
+    VM *vm;
+    Scanner scanner;
+    Compiler *compiler;
+    Chunk *chunk;
+    Token current;
+    Token previous;
+    // The expression parsed last. Every parse rule sets it, and infix rules
+    // take their left operand from it.
+    Node *expr;
+    // Source line of the node being emitted.
+    int line;
+    // Carried over from the parts of the script compiled before this one.
+    CompileState *state;
+    bool hadError;
+    bool panicMode;
+} Parser;
 
-Compiler *current = NULL;
+typedef void (*ParseFn)(Parser *parser, bool canAssign);
 
-Chunk *compilingChunk;
+typedef struct {
+    ParseFn prefix;
+    ParseFn infix;
+    Precedence precedence;
+} ParseRule;
 
-static Chunk *currentChunk() {
-    return compilingChunk;
+static Chunk *currentChunk(Parser *parser) {
+    return parser->compiler->chunk;
 }
 
-static void errorAt(Token *token, const char *message) {
-    if (parser.panicMode) return;
-    parser.panicMode = true;
-    fprintf(stderr, "[line %d] Error", token->line);
+static void errorAt(Parser *parser, Token *token, const char *message) {
+    if (parser->panicMode) return;
+    parser->panicMode = true;
+    fprintf(parser->vm->err, "[line %d] Error", token->line);
 
     if (token->type == T_EOF) {
-        fprintf(stderr, " at end");
+        fprintf(parser->vm->err, " at end");
     } else if (token->type == T_ERR) {
     } else {
-        fprintf(stderr, " at '%.*s'", token->length, token->start);
+        fprintf(parser->vm->err, " at '%.*s'", token->length, token->start);
     }
 
-    fprintf(stderr, ": %s\n", message);
-    parser.hadError = true;
+    fprintf(parser->vm->err, ": %s\n", message);
+    parser->hadError = true;
+}
+
+static void error(Parser *parser, const char *message) {
+    errorAt(parser, &parser->previous, message);
 }
 
-static void error(const char *message) {
-    errorAt(&parser.previous, message);
+static void errorAtCurrent(Parser *parser, const char *message) {
+    errorAt(parser, &parser->current, message);
 }
 
-static void errorAtCurrent(const char *message) {
-    errorAt(&parser.current, message);
+// Reports a limit of the bytecode that only shows once the tree is emitted,
+// at the line of the node being emitted.
+static void emitError(Parser *parser, const char *message) {
+    if (parser->panicMode) return;
+    parser->panicMode = true;
+    fprintf(parser->vm->err, "[line %d] Error: %s\n", parser->line, message);
+    parser->hadError = true;
 }
 
-static void advance() {
-    parser.previous = parser.current;
+static void advance(Parser *parser) {
+    parser->previous = parser->current;
     for (;;) {
-        parser.current = scanToken();
-        if (parser.current.type != T_ERR) break;
-        errorAtCurrent(parser.current.start);
+        parser->current = scanToken(&parser->scanner);
+        if (parser->current.type != T_ERR) break;
+        errorAtCurrent(parser, parser->current.start);
     }
 }
 
-static void consume(TokenType type, const char *message) {
-    if (parser.current.type == type) {
-        advance();
+static void consume(Parser *parser, TokenType type, const char *message) {
+    if (parser->current.type == type) {
+        advance(parser);
         return;
     }
-    errorAtCurrent(message);
+    errorAtCurrent(parser, message);
 }
 
-static bool check(TokenType type) {
-    return parser.current.type == type;
+static bool check(Parser *parser, TokenType type) {
+    return parser->current.type == type;
 }
 
-static bool match(TokenType type) {
-    if (!check(type)) return false;
-    advance();
+static bool match(Parser *parser, TokenType type) {
+    if (!check(parser, type)) return false;
+    advance(parser);
     return true;
 }
 
-static void emitByte(uint8_t byte) {
-    writeChunk(currentChunk(), byte, parser.previous.line);
+
+static void emitByte(Parser *parser, uint8_t byte) {
+    writeChunk(parser->vm, currentChunk(parser), byte, parser->line);
+}
+
+static void emitBytes(Parser *parser, uint8_t b1, uint8_t b2) {
+    emitByte(parser, b1);
+    emitByte(parser, b2);
 }
 
-static void emitBytes(uint8_t b1, uint8_t b2) {
-    emitByte(b1);
-    emitByte(b2);
+// Emits the instruction for `node`, after whatever its operands emitted,
+// at the node's line.
+static void emitOp(Parser *parser, Node *node, uint8_t op) {
+    parser->line = node->line;
+    emitByte(parser, op);
 }
 
-static void emitLoop(int loopStart) {
-    emitByte(OP_LOOP);
-    int offset = currentChunk()->count - loopStart + 2;
-    if (offset > UINT16_MAX) error("Loop body too large");
-    emitByte((offset >> 8) & 0xff);
-    emitByte(offset & 0xff);
+static void emitLoop(Parser *parser, int loopStart) {
+    emitByte(parser, OP_LOOP);
+    int offset = currentChunk(parser)->count - loopStart + 2;
+    if (offset > UINT16_MAX) emitError(parser, "Loop body too large");
+    emitByte(parser, (offset >> 8) & 0xff);
+    emitByte(parser, offset & 0xff);
 }
 
-static int emitJump(uint8_t intsruction) {
-    emitByte(intsruction);
-    emitByte(0xff);
-    emitByte(0xff);
-    return currentChunk()->count - 2;
+static int emitJump(Parser *parser, uint8_t intsruction) {
+    emitByte(parser, intsruction);
+    emitByte(parser, 0xff);
+    emitByte(parser, 0xff);
+    return currentChunk(parser)->count - 2;
 }
 
-static void emitReturn() {
-    emitByte(OP_RETURN);
+static void emitReturn(Parser *parser) {
+    // Falling off the end of a function returns nil; the script's own
+    // return leaves the stack as it is.
+    if (parser->compiler->function != NULL) emitByte(parser, OP_NULL);
+    emitByte(parser, OP_RETURN);
 }
 
-static uint8_t makeConstant(Value value) {
-    int constant = addConstant(currentChunk(), value);
+static uint8_t makeConstant(Parser *parser, Value value) {
+    // Constants are shared, since the optimizer may copy one to many uses.
+    ValueArray *constants = &currentChunk(parser)->constants;
+    for (int i = 0; i < constants->count && i <= UINT8_MAX; i++) {
+        if (valuesIdentical(constants->values[i], value)) return (uint8_t) i;
+    }
+    int constant = addConstant(parser->vm, currentChunk(parser), value);
     if (constant > UINT8_MAX) {
-        error("Too many constants in one chunk.");
+        emitError(parser, "Too many constants in one chunk.");
         return 0;
     }
     return (uint8_t) constant;
 }
 
-static void emitConstant(Value value) {
-    emitBytes(OP_CONSTANT, makeConstant(value));
+static void emitConstant(Parser *parser, Value value) {
+    emitBytes(parser, OP_CONSTANT, makeConstant(parser, value));
 }
 
-static void patchJump(int offset) {
-    int jump = currentChunk()->count - offset - 2;
+static void patchJump(Parser *parser, int offset) {
+    int jump = currentChunk(parser)->count - offset - 2;
     if (jump > UINT16_MAX) {
-        error("Too much code to jump over");
+        emitError(parser, "Too much code to jump over");
+    }
+
+    currentChunk(parser)->code[offset] = (jump >> 8) & 0xff;
+    currentChunk(parser)->code[offset + 1] = jump & 0xff;
+}
+
+static uint8_t slotOf(Parser *parser, int var) {
+    return (uint8_t) parser->compiler->ir->vars[var].slot;
+}
+
+static void emitExpression(Parser *parser, Node *node);
+
+static void emitStatement(Parser *parser, Node *node);
+
+static void emitOperands(Parser *parser, Node *node) {
+    if (node->a != NULL) emitExpression(parser, node->a);
+    if (node->b != NULL) emitExpression(parser, node->b);
+    if (node->c != NULL) emitExpression(parser, node->c);
+    for (int i = 0; i < node->count; i++) emitExpression(parser, node->items[i]);
+}
+
+static void emitBinary(Parser *parser, Node *node) {
+    emitOperands(parser, node);
+    // With both operands proven numeric the unchecked opcodes apply.
+    if (node->a->type == TYPE_NUMBER && node->b->type == TYPE_NUMBER) {
+        switch (node->op) {
+            case T_GT:
+                emitOp(parser, node, OP_GREATER_NN);
+                return;
+            case T_GTE:
+                emitOp(parser, node, OP_LESS_NN);
+                emitByte(parser, OP_NOT);
+                return;
+            case T_LT:
+                emitOp(parser, node, OP_LESS_NN);
+                return;
+            case T_LTE:
+                emitOp(parser, node, OP_GREATER_NN);
+                emitByte(parser, OP_NOT);
+                return;
+            case T_PLUS:
+                emitOp(parser, node, OP_ADD_NN);
+                return;
+            case T_MINUS:
+                emitOp(parser, node, OP_SUB_NN);
+                return;
+            case T_ASTERISK:
+                emitOp(parser, node, OP_MUL_NN);
+                return;
+            case T_SLASH:
+                emitOp(parser, node, OP_DIV_NN);
+                return;
+            default:
+                break;
+        }
+    }
+
+    switch (node->op) {
+        case T_NE:
+            emitOp(parser, node, OP_EQUAL);
+            emitByte(parser, OP_NOT);
+            break;
+        case T_EQ:
+            emitOp(parser, node, OP_EQUAL);
+            break;
+        case T_GT:
+            emitOp(parser, node, OP_GREATER);
+            break;
+        case T_GTE:
+            emitOp(parser, node, OP_LESS);
+            emitByte(parser, OP_NOT);
+            break;
+        case T_LT:
+            emitOp(parser, node, OP_LESS);
+            break;
+        case T_LTE:
+            emitOp(parser, node, OP_GREATER);
+            emitByte(parser, OP_NOT);
+            break;
+        case T_PLUS:
+            emitOp(parser, node, OP_ADD);
+            break;
+        case T_MINUS:
+            emitOp(parser, node, OP_SUB);
+            break;
+        case T_ASTERISK:
+            emitOp(parser, node, OP_MUL);
+            break;
+        case T_SLASH:
+            emitOp(parser, node, OP_DIV);
+            break;
     }
+}
 
-    currentChunk()->code[offset] = (jump >> 8) & 0xff;
-    currentChunk()->code[offset + 1] = jump & 0xff;
+static void emitExpression(Parser *parser, Node *node) {
+    switch (node->kind) {
+        case N_CONSTANT:
+            parser->line = node->line;
+            if (IS_NULL(node->value)) {
+                emitByte(parser, OP_NULL);
+            } else if (IS_BOOL(node->value)) {
+                emitByte(parser, AS_BOOL(node->value) ? OP_TRUE : OP_FALSE);
+            } else {
+                emitConstant(parser, node->value);
+            }
+            break;
+        case N_GET_LOCAL:
+            emitOp(parser, node, OP_GET_LOCAL);
+            emitByte(parser, slotOf(parser, node->var));
+            break;
+        case N_SET_LOCAL:
+            emitExpression(parser, node->a);
+            emitOp(parser, node, OP_SET_LOCAL);
+            emitByte(parser, slotOf(parser, node->var));
+            break;
+        case N_GET_GLOBAL:
+            emitOp(parser, node, OP_GET_GLOBAL);
+            emitByte(parser, makeConstant(parser, OBJ_VAL(node->name)));
+            break;
+        case N_SET_GLOBAL:
+            emitExpression(parser, node->a);
+            emitOp(parser, node, OP_SET_GLOBAL);
+            emitByte(parser, makeConstant(parser, OBJ_VAL(node->name)));
+            break;
+        case N_BINARY:
+            emitBinary(parser, node);
+            break;
+        case N_UNARY:
+            emitExpression(parser, node->a);
+            if (node->op == T_BANG) {
+                emitOp(parser, node, OP_NOT);
+            } else {
+                emitOp(parser, node, node->a->type == TYPE_NUMBER ? OP_NEGATE_NN : OP_NEGATE);
+            }
+            break;
+        case N_AND: {
+            emitExpression(parser, node->a);
+            parser->line = node->line;
+            int endJump = emitJump(parser, OP_JUMP_IF_FALSE);
+            emitByte(parser, OP_POP);
+            emitExpression(parser, node->b);
+            patchJump(parser, endJump);
+            break;
+        }
+        case N_OR: {
+            emitExpression(parser, node->a);
+            parser->line = node->line;
+            int elseJump = emitJump(parser, OP_JUMP_IF_FALSE);
+            int endJump = emitJump(parser, OP_JUMP);
+            patchJump(parser, elseJump);
+            emitByte(parser, OP_POP);
+            emitExpression(parser, node->b);
+            patchJump(parser, endJump);
+            break;
+        }
+        case N_LIST:
+            emitOperands(parser, node);
+            emitOp(parser, node, OP_BUILD_LIST);
+            emitByte(parser, (uint8_t) node->count);
+            break;
+        case N_MAP:
+            emitOperands(parser, node);
+            emitOp(parser, node, OP_BUILD_MAP);
+            emitByte(parser, (uint8_t) (node->count / 2));
+            break;
+        case N_CALL: {
+            emitOperands(parser, node);
+            // Fast natives take one to three numbers.
+            bool numeric = node->count >= 1 && node->count <= 3;
+            for (int i = 0; i < node->count; i++) {
+                if (node->items[i]->type != TYPE_NUMBER) numeric = false;
+            }
+            emitOp(parser, node, numeric ? OP_CALL_NN : OP_CALL);
+            emitByte(parser, (uint8_t) node->count);
+            break;
+        }
+        case N_INDEX_GET:
+            emitOperands(parser, node);
+            emitOp(parser, node, OP_INDEX_GET);
+            break;
+        case N_INDEX_SET:
+            emitOperands(parser, node);
+            emitOp(parser, node, OP_INDEX_SET);
+            break;
+        case N_METHOD:
+            emitOperands(parser, node);
+            emitOp(parser, node, (uint8_t) node->op);
+            break;
+        default:
+            break;
+    }
 }
 
-static void initCompiler(Compiler *compiler) {
+static void emitStatement(Parser *parser, Node *node) {
+    switch (node->kind) {
+        case N_EXPRESSION:
+            emitExpression(parser, node->a);
+            emitByte(parser, OP_POP);
+            break;
+        case N_PUTS:
+            emitExpression(parser, node->a);
+            emitOp(parser, node, OP_PUTS);
+            break;
+        case N_LET: {
+            emitExpression(parser, node->a);
+            // The value just pushed is the local's slot from here on.
+            Compiler *compiler = parser->compiler;
+            if (compiler->slotCount == UINT8_COUNT) {
+                emitError(parser, "Too many variables in one scope");
+                return;
+            }
+            compiler->ir->vars[node->var].slot = compiler->slotCount++;
+            break;
+        }
+        case N_DEFINE_GLOBAL:
+            emitExpression(parser, node->a);
+            emitOp(parser, node, OP_DEFINE_GLOBAL);
+            emitByte(parser, makeConstant(parser, OBJ_VAL(node->name)));
+            break;
+        case N_BLOCK: {
+            int slotCount = parser->compiler->slotCount;
+            for (int i = 0; i < node->count; i++) emitStatement(parser, node->items[i]);
+            if (node->pops) {
+                for (int i = slotCount; i < parser->compiler->slotCount; i++) emitByte(parser, OP_POP);
+            }
+            parser->compiler->slotCount = slotCount;
+            break;
+        }
+        case N_IF: {
+            emitExpression(parser, node->a);
+            parser->line = node->line;
+            int thenJump = emitJump(parser, OP_JUMP_IF_FALSE);
+            emitByte(parser, OP_POP);
+            emitStatement(parser, node->b);
+            int elseJump = emitJump(parser, OP_JUMP);
+            patchJump(parser, thenJump);
+            emitByte(parser, OP_POP);
+            if (node->c != NULL) emitStatement(parser, node->c);
+            patchJump(parser, elseJump);
+            break;
+        }
+        case N_WHILE: {
+            int loopStart = currentChunk(parser)->count;
+            // A condition that is always true needs no test.
+            bool forever = node->a->kind == N_CONSTANT && !IS_NULL(node->a->value) &&
+                           !(IS_BOOL(node->a->value) && !AS_BOOL(node->a->value));
+            int exitJump = -1;
+            if (!forever) {
+                emitExpression(parser, node->a);
+                exitJump = emitJump(parser, OP_JUMP_IF_FALSE);
+                emitByte(parser, OP_POP);
+            }
+            emitStatement(parser, node->b);
+            parser->line = node->line;
+            emitLoop(parser, loopStart);
+            if (exitJump != -1) {
+                patchJump(parser, exitJump);
+                emitByte(parser, OP_POP);
+            }
+            break;
+        }
+        case N_RETURN:
+            if (node->a == NULL) {
+                parser->line = node->line;
+                emitReturn(parser);
+            } else if (node->a->kind == N_CALL) {
+                // A call whose result is returned unchanged reuses the frame.
+                emitOperands(parser, node->a);
+                emitOp(parser, node->a, OP_TAIL_CALL);
+                emitByte(parser, (uint8_t) node->a->count);
+                emitByte(parser, OP_RETURN);
+            } else {
+                emitExpression(parser, node->a);
+                emitOp(parser, node, OP_RETURN);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Optimizes a finished tree and emits it into the current chunk. Code with
+// errors never runs, so it is neither.
+static void emitTree(Parser *parser, Node *root) {
+    if (parser->hadError) return;
+    Compiler *compiler = parser->compiler;
+    root = optimize(parser->vm, compiler->ir, root, &parser->state->defined);
+    compiler->slotCount = compiler->ir->paramCount;
+    for (int i = 0; i < compiler->ir->paramCount; i++) compiler->ir->vars[i].slot = i;
+    if (root->kind == N_BLOCK) {
+        emitStatement(parser, root);
+    } else {
+        emitExpression(parser, root);
+    }
+}
+
+static void initCompiler(Parser *parser, Compiler *compiler, ObjFunction *function, Ir *ir) {
+    compiler->enclosing = parser->compiler;
+    compiler->function = function;
+    compiler->chunk = function != NULL ? &function->chunk : parser->chunk;
+    compiler->ir = ir;
     compiler->localCount = 0;
     compiler->scopeDepth = 0;
-    current = compiler;
+    compiler->slotCount = 0;
+    parser->compiler = compiler;
+    if (function != NULL) {
+        // Slot 0 of a call frame holds the function being called.
+        Local *local = &compiler->locals[compiler->localCount++];
+        local->name.start = "";
+        local->name.length = 0;
+        local->depth = 0;
+        local->var = newVar(ir, false);
+    }
 }
 
-static void endCompiler() {
-    emitReturn();
+static void endCompiler(Parser *parser) {
+    parser->line = parser->previous.line;
+    emitReturn(parser);
 #ifdef DEBUG_PRINT_CODE
-    if (!parser.hadError) {
-        disassembleChunk(currentChunk(), "code");
+    if (!parser->hadError) {
+        ObjFunction *function = parser->compiler->function;
+        disassembleChunk(parser->vm, currentChunk(parser), function != NULL ? function->name->chars : "code");
     }
 #endif
+    parser->compiler = parser->compiler->enclosing;
 }
 
-static void beginScope() {
-    current->scopeDepth++;
+static void beginScope(Parser *parser) {
+    parser->compiler->scopeDepth++;
 }
 
-static void endScope() {
-    current->scopeDepth--;
+// Locals going out of scope are popped by the block that declared them when
+// it is emitted.
+static void endScope(Parser *parser) {
+    parser->compiler->scopeDepth--;
 
-    while (current->localCount > 0 &&
-           current->locals[current->localCount - 1].depth >
-           current->scopeDepth) {
-        emitByte(OP_POP);
-        current->localCount--;
+    while (parser->compiler->localCount > 0 &&
+           parser->compiler->locals[parser->compiler->localCount - 1].depth >
+           parser->compiler->scopeDepth) {
+        parser->compiler->localCount--;
     }
 }
 
-static void expression();
+static Node *expression(Parser *parser);
 
-static void statement();
+static Node *statement(Parser *parser);
 
-static void declaration();
+static Node *declaration(Parser *parser);
 
 static ParseRule *getRule(TokenType type);
 
-static void parsePrecedence(Precedence precedence);
+static void parsePrecedence(Parser *parser, Precedence precedence);
+
+static Node *makeNode(Parser *parser, NodeKind kind) {
+    return newNode(parser->compiler->ir, kind, parser->previous.line);
+}
+
+static Node *constantNode(Parser *parser, Value value) {
+    return newConstant(parser->compiler->ir, value, parser->previous.line);
+}
 
-static uint8_t identifierConstant(Token *name) {
-    return makeConstant(OBJ_VAL(copyString(name->start, name->length)));
+static Node *makeBlock(Parser *parser) {
+    Node *block = makeNode(parser, N_BLOCK);
+    block->pops = true;
+    return block;
 }
 
 static bool identifiersEqual(Token *a, Token *b) {
@@ -217,12 +580,12 @@ static bool identifiersEqual(Token *a, Token *b) {
     return memcmp(a->start, b->start, a->length) == 0;
 }
 
-static int resolveLocal(Compiler *compiler, Token *name) {
+static int resolveLocal(Parser *parser, Compiler *compiler, Token *name) {
     for (int i = compiler->localCount - 1; i >= 0; i--) {
         Local *local = &compiler->locals[i];
         if (identifiersEqual(name, &local->name)) {
             if (local->depth == -1) {
-                error("Can't initialize a variable with itself");
+                error(parser, "Can't initialize a variable with itself");
             }
             return i;
         }
@@ -230,190 +593,281 @@ static int resolveLocal(Compiler *compiler, Token *name) {
     return -1;
 }
 
-static void addLocal(Token name) {
-    if (current->localCount == UINT8_COUNT) {
-        error("Too many variables in one scope");
+static void addLocal(Parser *parser, Token name) {
+    if (parser->compiler->localCount == UINT8_COUNT) {
+        error(parser, "Too many variables in one scope");
         return;
     }
-    Local *local = &current->locals[current->localCount++];
+    Local *local = &parser->compiler->locals[parser->compiler->localCount++];
     local->name = name;
     local->depth = -1;
+    local->var = newVar(parser->compiler->ir, false);
 }
 
-static void declareVariable() {
-    if (current->scopeDepth == 0) return;
-    Token *name = &parser.previous;
-    for (int i = current->localCount - 1; i >= 0; i--) {
-        Local *local = &current->locals[i];
-        if (local->depth != -1 && local->depth < current->scopeDepth) {
+static void declareVariable(Parser *parser) {
+    if (parser->compiler->scopeDepth == 0) return;
+    Token *name = &parser->previous;
+    for (int i = parser->compiler->localCount - 1; i >= 0; i--) {
+        Local *local = &parser->compiler->locals[i];
+        if (local->depth != -1 && local->depth < parser->compiler->scopeDepth) {
             break;
         }
 
         if (identifiersEqual(name, &local->name)) {
-            error("Variable with this name is already declared in this scope");
+            error(parser, "Variable with this name is already declared in this scope");
         }
     }
-    addLocal(*name);
+    addLocal(parser, *name);
 }
 
-static uint8_t parseVariable(const char *errorMessage) {
-    consume(T_IDENT, errorMessage);
-    declareVariable();
-    if (current->scopeDepth > 0) return 0;
-    return identifierConstant(&parser.previous);
+static Token parseVariable(Parser *parser, const char *errorMessage) {
+    consume(parser, T_IDENT, errorMessage);
+    declareVariable(parser);
+    return parser->previous;
 }
 
-static void markInitialized() {
-    current->locals[current->localCount - 1].depth = current->scopeDepth;
+static void markInitialized(Parser *parser) {
+    parser->compiler->locals[parser->compiler->localCount - 1].depth = parser->compiler->scopeDepth;
 }
 
-static void defineVariable(uint8_t global) {
-    if (current->scopeDepth > 0) {
-        markInitialized();
-        return;
+// The declaration of a local, or of a global at the top level, that `name`
+// was parsed as.
+static Node *defineVariable(Parser *parser, Token name, Node *value) {
+    Node *node;
+    if (parser->compiler->scopeDepth > 0) {
+        markInitialized(parser);
+        node = makeNode(parser, N_LET);
+        node->var = parser->compiler->locals[parser->compiler->localCount - 1].var;
+    } else {
+        node = makeNode(parser, N_DEFINE_GLOBAL);
+        node->name = copyString(parser->vm, name.start, name.length);
     }
-    emitBytes(OP_DEFINE_GLOBAL, global);
+    node->a = value;
+    return node;
 }
 
-static void and_(bool canAssign) {
-    int endJump = emitJump(OP_JUMP_IF_FALSE);
-
-    emitByte(OP_POP);
-    parsePrecedence(AND);
-    patchJump(endJump);
+static void and_(Parser *parser, bool canAssign) {
+    Node *node = makeNode(parser, N_AND);
+    node->a = parser->expr;
+    parsePrecedence(parser, AND);
+    node->b = parser->expr;
+    parser->expr = node;
 }
 
-static void binary(bool canAssign) {
-    TokenType operatorType = parser.previous.type;
+static void binary(Parser *parser, bool canAssign) {
+    Node *node = makeNode(parser, N_BINARY);
+    node->op = parser->previous.type;
+    node->a = parser->expr;
 
-    ParseRule *rule = getRule(operatorType);
-    parsePrecedence((Precedence) (rule->precedence + 1));
-
-    switch (operatorType) {
-        case T_NE:
-            emitBytes(OP_EQUAL, OP_NOT);
-            break;
-        case T_EQ:
-            emitByte(OP_EQUAL);
-            break;
-        case T_GT:
-            emitByte(OP_GREATER);
-            break;
-        case T_GTE:
-            emitBytes(OP_LESS, OP_NOT);
-            break;
-        case T_LT:
-            emitByte(OP_LESS);
-            break;
-        case T_LTE:
-            emitBytes(OP_GREATER, OP_NOT);
-            break;
-        case T_PLUS:
-            emitByte(OP_ADD);
-            break;
-        case T_MINUS:
-            emitByte(OP_SUB);
-            break;
-        case T_ASTERISK:
-            emitByte(OP_MUL);
-            break;
-        case T_SLASH:
-            emitByte(OP_DIV);
-            break;
-    }
+    ParseRule *rule = getRule(node->op);
+    parsePrecedence(parser, (Precedence) (rule->precedence + 1));
+    node->b = parser->expr;
+    parser->expr = node;
 }
 
-static void literal(bool canAssign) {
-    switch (parser.previous.type) {
+static void literal(Parser *parser, bool canAssign) {
+    switch (parser->previous.type) {
         case T_FALSE:
-            emitByte(OP_FALSE);
+            parser->expr = constantNode(parser, BOOL_VAL(false));
             break;
         case T_TRUE:
-            emitByte(OP_TRUE);
-            break;
-        case T_NULL:
-            emitByte(OP_NULL);
+            parser->expr = constantNode(parser, BOOL_VAL(true));
             break;
         default:
-            return;
+            parser->expr = constantNode(parser, NULL_VAL);
+            break;
     }
 }
 
-static void grouping(bool canAssign) {
-    expression();
-    consume(T_RPAREN, "`)` is expected after expression.");
+static void grouping(Parser *parser, bool canAssign) {
+    expression(parser);
+    consume(parser, T_RPAREN, "`)` is expected after expression.");
 }
 
-static void number(bool canAssign) {
-    double value = strtod(parser.previous.start, NULL);
-    emitConstant(NUM_VAL(value));
+static void number(Parser *parser, bool canAssign) {
+    // Literals without a fraction are integers unless they overflow int64.
+    if (memchr(parser->previous.start, '.', parser->previous.length) == NULL) {
+        errno = 0;
+        long long value = strtoll(parser->previous.start, NULL, 10);
+        if (errno == 0) {
+            parser->expr = constantNode(parser, INT_VAL(value));
+            return;
+        }
+    }
+    double value = strtod(parser->previous.start, NULL);
+    parser->expr = constantNode(parser, NUM_VAL(value));
 }
 
-static void or_(bool canAssign) {
-    int elseJump = emitJump(OP_JUMP_IF_FALSE);
-    int endJump = emitJump(OP_JUMP);
-
-    patchJump(elseJump);
-    emitByte(OP_POP);
+static void or_(Parser *parser, bool canAssign) {
+    Node *node = makeNode(parser, N_OR);
+    node->a = parser->expr;
+    parsePrecedence(parser, OR);
+    node->b = parser->expr;
+    parser->expr = node;
+}
 
-    parsePrecedence(OR);
-    patchJump(endJump);
+static void string(Parser *parser, bool canAssign) {
+    ObjString *chars = copyString(parser->vm, parser->previous.start + 1, parser->previous.length - 2);
+    parser->expr = constantNode(parser, OBJ_VAL(chars));
 }
 
-static void string(bool canAssign) {
-    emitConstant(OBJ_VAL(copyString(parser.previous.start + 1, parser.previous.length - 2)));
+// Functions only see their own locals and globals; there are no closures.
+static void checkNotCaptured(Parser *parser, Token *name) {
+    for (Compiler *outer = parser->compiler->enclosing; outer != NULL; outer = outer->enclosing) {
+        if (resolveLocal(parser, outer, name) != -1) {
+            error(parser, "Functions cannot use local variables of the enclosing code.");
+            return;
+        }
+    }
 }
 
-static void namedVariable(Token name, bool canAssign) {
-    uint8_t getOp, setOp;
-    int arg = resolveLocal(current, &name);
-    if (arg != -1) {
-        getOp = OP_GET_LOCAL;
-        setOp = OP_SET_LOCAL;
+static void namedVariable(Parser *parser, Token name, bool canAssign) {
+    Node *node = makeNode(parser, N_GET_GLOBAL);
+    int local = resolveLocal(parser, parser->compiler, &name);
+    if (local != -1) {
+        node->kind = N_GET_LOCAL;
+        node->var = parser->compiler->locals[local].var;
     } else {
-        arg = identifierConstant(&name);
-        getOp = OP_GET_GLOBAL;
-        setOp = OP_SET_GLOBAL;
+        checkNotCaptured(parser, &name);
+        node->name = copyString(parser->vm, name.start, name.length);
     }
-    if (canAssign && match(T_ASSIGN)) {
-        expression();
-        emitBytes(setOp, (uint8_t) arg);
-    } else {
-        emitBytes(getOp, (uint8_t) arg);
+    if (canAssign && match(parser, T_ASSIGN)) {
+        node->kind = node->kind == N_GET_LOCAL ? N_SET_LOCAL : N_SET_GLOBAL;
+        node->a = expression(parser);
     }
+    parser->expr = node;
 }
 
-static void variable(bool canAssign) {
-    namedVariable(parser.previous, canAssign);
+static void variable(Parser *parser, bool canAssign) {
+    namedVariable(parser, parser->previous, canAssign);
 }
 
-static void unary(bool canAssign) {
-    TokenType operatorType = parser.previous.type;
+static void list(Parser *parser, bool canAssign) {
+    Node *node = makeNode(parser, N_LIST);
+    do {
+        if (check(parser, T_RBRACK)) break;
+        addItem(node, expression(parser));
+        if (node->count == UINT8_COUNT) error(parser, "Too many elements in a list literal.");
+    } while (match(parser, T_COMMA));
+    consume(parser, T_RBRACK, "`]` expected after list elements.");
+    parser->expr = node;
+}
 
-    parsePrecedence(PREFIX);
+// `{` only starts a map in expression position; as a statement it is still
+// a block.
+static void map(Parser *parser, bool canAssign) {
+    Node *node = makeNode(parser, N_MAP);
+    do {
+        if (check(parser, T_RBRACE)) break;
+        addItem(node, expression(parser));
+        consume(parser, T_COLON, "`:` expected after map key.");
+        addItem(node, expression(parser));
+        if (node->count == UINT8_COUNT * 2) error(parser, "Too many entries in a map literal.");
+    } while (match(parser, T_COMMA));
+    consume(parser, T_RBRACE, "`}` expected after map entries.");
+    parser->expr = node;
+}
 
-    switch (operatorType) {
-        case T_BANG:
-            emitByte(OP_NOT);
-            break;
-        case T_MINUS:
-            emitByte(OP_NEGATE);
-            break;
-        default:
-            return;
+static void call(Parser *parser, bool canAssign) {
+    Node *node = makeNode(parser, N_CALL);
+    node->a = parser->expr;
+    if (!check(parser, T_RPAREN)) {
+        do {
+            addItem(node, expression(parser));
+            if (node->count == UINT8_COUNT) error(parser, "Too many arguments.");
+        } while (match(parser, T_COMMA));
+    }
+    consume(parser, T_RPAREN, "`)` expected after arguments.");
+    parser->expr = node;
+}
+
+static void subscript(Parser *parser, bool canAssign) {
+    Node *node = makeNode(parser, N_INDEX_GET);
+    node->a = parser->expr;
+    node->b = expression(parser);
+    consume(parser, T_RBRACK, "`]` expected after index.");
+    if (canAssign && match(parser, T_ASSIGN)) {
+        node->kind = N_INDEX_SET;
+        node->c = expression(parser);
     }
+    parser->expr = node;
+}
+
+// Built-in properties and methods, resolved at compile time to a single
+// opcode that checks the receiver's type when it runs. A negative arity is
+// a property, written without parentheses. `result` is what the opcode
+// leaves when it does not fail.
+typedef struct {
+    const char *name;
+    int arity;
+    OpCode op;
+    StaticType result;
+} Method;
+
+static const Method methods[] = {
+        {"length", -1, OP_LENGTH,    TYPE_NUMBER},
+        {"append", 1,  OP_APPEND,    TYPE_ANY},
+        {"has",    1,  OP_HAS,       TYPE_BOOL},
+        {"remove", 1,  OP_REMOVE,    TYPE_BOOL},
+        {"float64", 0, OP_FLOAT64,   TYPE_ANY},
+        {"sum",    0,  OP_SUM,       TYPE_NUMBER},
+        {"min",    0,  OP_MIN,       TYPE_ANY},
+        {"max",    0,  OP_MAX,       TYPE_ANY},
+        {"dot",    1,  OP_DOT,       TYPE_NUMBER},
+        {"scale",  1,  OP_SCALE,     TYPE_ANY},
+        {"add",    1,  OP_ARRAY_ADD, TYPE_ANY},
+        {"mul",    1,  OP_ARRAY_MUL, TYPE_ANY},
+};
+
+static void dot(Parser *parser, bool canAssign) {
+    Node *node = makeNode(parser, N_METHOD);
+    node->a = parser->expr;
+    parser->expr = node;
+    consume(parser, T_IDENT, "Property name expected after `.`.");
+    Token name = parser->previous;
+    for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++) {
+        const Method *method = &methods[i];
+        if ((int) strlen(method->name) != name.length ||
+            memcmp(method->name, name.start, name.length) != 0) {
+            continue;
+        }
+        if (method->arity >= 0) {
+            consume(parser, T_LPAREN, "`(` expected after method name.");
+            for (int arg = 0; arg < method->arity; arg++) {
+                if (arg > 0) consume(parser, T_COMMA, "`,` expected between arguments.");
+                addItem(node, expression(parser));
+            }
+            consume(parser, T_RPAREN, "`)` expected after arguments.");
+        }
+        node->op = method->op;
+        node->type = method->result;
+        parser->expr = node;
+        return;
+    }
+    error(parser, "Unknown property.");
+}
+
+static void unary(Parser *parser, bool canAssign) {
+    Node *node = makeNode(parser, N_UNARY);
+    node->op = parser->previous.type;
+    parsePrecedence(parser, PREFIX);
+    node->a = parser->expr;
+    parser->expr = node;
 }
 
 ParseRule rules[] = {
-        [T_LPAREN]            = {grouping, NULL, NONE},
+        [T_LPAREN]            = {grouping, call, CALL},
         [T_RPAREN]            = {NULL, NULL, NONE},
-        [T_LBRACE]            = {NULL, NULL, NONE},
+        [T_LBRACE]            = {map, NULL, NONE},
         [T_RBRACE]            = {NULL, NULL, NONE},
+        [T_LBRACK]            = {list, subscript, CALL},
+        [T_RBRACK]            = {NULL, NULL, NONE},
         [T_COMMA]             = {NULL, NULL, NONE},
-        [T_DOT]               = {NULL, NULL, NONE},
+        [T_DOT]               = {NULL, dot, CALL},
         [T_MINUS]             = {unary, binary, SUM},
         [T_PLUS]              = {NULL, binary, SUM},
         [T_SEMICOLON]         = {NULL, NULL, NONE},
+        [T_COLON]             = {NULL, NULL, NONE},
         [T_SLASH]             = {NULL, binary, PRODUCT},
         [T_ASTERISK]          = {NULL, binary, PRODUCT},
         [T_BANG]              = {unary, NULL, NONE},
@@ -447,25 +901,26 @@ ParseRule rules[] = {
         [T_EOF]               = {NULL, NULL, NONE},
 };
 
-static void parsePrecedence(Precedence precedence) {
-    advance();
-    ParseFn prefixRule = getRule(parser.previous.type)->prefix;
+static void parsePrecedence(Parser *parser, Precedence precedence) {
+    advance(parser);
+    ParseFn prefixRule = getRule(parser->previous.type)->prefix;
     if (prefixRule == NULL) {
-        error("Expression is expected.");
+        error(parser, "Expression is expected.");
+        parser->expr = constantNode(parser, NULL_VAL);
         return;
     }
 
     bool canAssign = precedence <= ASSIGNMENT;
-    prefixRule(canAssign);
+    prefixRule(parser, canAssign);
 
-    while (precedence <= getRule(parser.current.type)->precedence) {
-        advance();
-        ParseFn infixRule = getRule(parser.previous.type)->infix;
-        infixRule(canAssign);
+    while (precedence <= getRule(parser->current.type)->precedence) {
+        advance(parser);
+        ParseFn infixRule = getRule(parser->previous.type)->infix;
+        infixRule(parser, canAssign);
     }
 
-    if (canAssign && match(T_ASSIGN)) {
-        error("Invalid assignment target");
+    if (canAssign && match(parser, T_ASSIGN)) {
+        error(parser, "Invalid assignment target");
     }
 }
 
@@ -473,117 +928,167 @@ static ParseRule *getRule(TokenType type) {
     return &rules[type];
 }
 
-static void expression() {
-    parsePrecedence(ASSIGNMENT);
+static Node *expression(Parser *parser) {
+    parsePrecedence(parser, ASSIGNMENT);
+    return parser->expr;
 }
 
-static void block() {
-    while (!check(T_RBRACE) && !check(T_EOF)) {
-        declaration();
+static void block(Parser *parser, Node *node) {
+    while (!check(parser, T_RBRACE) && !check(parser, T_EOF)) {
+        addItem(node, declaration(parser));
     }
-    consume(T_RBRACE, "`}` expected at the end of a block");
+    consume(parser, T_RBRACE, "`}` expected at the end of a block");
 }
 
-static void varDeclaration() {
-    uint8_t global = parseVariable("Expected variable name");
-    if (match(T_ASSIGN)) {
-        expression();
+// The body of an `if` or a loop, always as a block so the optimizer has
+// somewhere to put the locals it adds.
+static Node *scopedStatement(Parser *parser) {
+    Node *body = statement(parser);
+    if (body->kind == N_BLOCK) return body;
+    Node *block = makeBlock(parser);
+    addItem(block, body);
+    return block;
+}
+
+static Node *varDeclaration(Parser *parser) {
+    Token name = parseVariable(parser, "Expected variable name");
+    Node *value;
+    if (match(parser, T_ASSIGN)) {
+        value = expression(parser);
     } else {
-        emitByte(OP_NULL);
+        value = constantNode(parser, NULL_VAL);
     }
 
-    consume(T_SEMICOLON, "`;` expected after variable declaration");
+    consume(parser, T_SEMICOLON, "`;` expected after variable declaration");
+    return defineVariable(parser, name, value);
+}
 
-    defineVariable(global);
+static Node *functionBody(Parser *parser) {
+    ObjFunction *function = newFunction(parser->vm,
+                                        copyString(parser->vm, parser->previous.start, parser->previous.length));
+    function->id = (uint16_t) ++parser->state->functionCount;
+    Ir ir;
+    initIr(&ir);
+    Compiler compiler;
+    initCompiler(parser, &compiler, function, &ir);
+    beginScope(parser);
+
+    consume(parser, T_LPAREN, "`(` expected after function name.");
+    if (!check(parser, T_RPAREN)) {
+        do {
+            if (function->arity == UINT8_MAX) errorAtCurrent(parser, "Too many parameters.");
+            function->arity++;
+            parseVariable(parser, "Parameter name expected.");
+            markInitialized(parser);
+        } while (match(parser, T_COMMA));
+    }
+    ir.paramCount = ir.varCount;
+    consume(parser, T_RPAREN, "`)` expected after parameters.");
+    consume(parser, T_LBRACE, "`{` expected before function body.");
+    Node *body = makeNode(parser, N_BLOCK);
+    block(parser, body);
+
+    // The frame is discarded on return, so the body needs no pops.
+    emitTree(parser, body);
+    endCompiler(parser);
+    freeIr(&ir);
+    return constantNode(parser, OBJ_VAL(function));
 }
 
-static void expressionStatement() {
-    expression();
-    consume(T_SEMICOLON, "`;` expected after expression.");
-    emitByte(OP_POP);
+static Node *funDeclaration(Parser *parser) {
+    Token name = parseVariable(parser, "Function name expected.");
+    // Marked before the body, so a local function that names itself is
+    // reported as a capture rather than as reading itself uninitialised.
+    if (parser->compiler->scopeDepth > 0) markInitialized(parser);
+    return defineVariable(parser, name, functionBody(parser));
 }
 
-static void forStatement() {
-    beginScope();
-    consume(T_LPAREN, "`(` expected after `for`");
+static Node *expressionStatement(Parser *parser) {
+    Node *node = makeNode(parser, N_EXPRESSION);
+    node->a = expression(parser);
+    consume(parser, T_SEMICOLON, "`;` expected after expression.");
+    return node;
+}
+
+// A `for` loop is a `while` loop in a scope of its own, with the increment
+// at the end of the body.
+static Node *forStatement(Parser *parser) {
+    beginScope(parser);
+    Node *scope = makeBlock(parser);
+    consume(parser, T_LPAREN, "`(` expected after `for`");
 
-    if (match(T_SEMICOLON)) {}
-    else if (match(T_LET)) {
-        varDeclaration();
+    if (match(parser, T_SEMICOLON)) {}
+    else if (match(parser, T_LET)) {
+        addItem(scope, varDeclaration(parser));
     } else {
-        expressionStatement();
+        addItem(scope, expressionStatement(parser));
     }
 
-    int loopStart = currentChunk()->count;
-
-    int exitJump = -1;
-
-    if (!match(T_SEMICOLON)) {
-        expression();
-        consume(T_SEMICOLON, "`;` expected after the loop condition");
-        exitJump = emitJump(OP_JUMP_IF_FALSE);
-        emitByte(OP_POP);
-    }
-    if (!match(T_RPAREN)) {
-        int bodyJump = emitJump(OP_JUMP);
-        int incrementStart = currentChunk()->count;
-        expression();
-        emitByte(OP_POP);
-        consume(T_RPAREN, "`)` expected after the clauses");
-        emitLoop(loopStart);
-        loopStart = incrementStart;
-        patchJump(bodyJump);
+    Node *loop = makeNode(parser, N_WHILE);
+    if (!match(parser, T_SEMICOLON)) {
+        loop->a = expression(parser);
+        consume(parser, T_SEMICOLON, "`;` expected after the loop condition");
+    } else {
+        loop->a = constantNode(parser, BOOL_VAL(true));
     }
-    statement();
-    emitLoop(loopStart);
-    if (exitJump != -1) {
-        patchJump(exitJump);
-        emitByte(OP_POP);
+    Node *increment = NULL;
+    if (!match(parser, T_RPAREN)) {
+        increment = makeNode(parser, N_EXPRESSION);
+        increment->a = expression(parser);
+        consume(parser, T_RPAREN, "`)` expected after the clauses");
     }
-    endScope();
+    loop->b = makeBlock(parser);
+    addItem(loop->b, scopedStatement(parser));
+    if (increment != NULL) addItem(loop->b, increment);
+    addItem(scope, loop);
+    endScope(parser);
+    return scope;
 }
 
-static void ifStatement() {
-    consume(T_LPAREN, "`(` expected after `if`");
-    expression();
-    consume(T_RPAREN, "`)` expected after condition");
-    int thenJump = emitJump(OP_JUMP_IF_FALSE);
-    emitByte(OP_POP);
-    statement();
-    int elseJump = emitJump(OP_JUMP);
-    patchJump(thenJump);
-    emitByte(OP_POP);
-    if (match(T_ELSE)) statement();
-    patchJump(elseJump);
+static Node *ifStatement(Parser *parser) {
+    Node *node = makeNode(parser, N_IF);
+    consume(parser, T_LPAREN, "`(` expected after `if`");
+    node->a = expression(parser);
+    consume(parser, T_RPAREN, "`)` expected after condition");
+    node->b = scopedStatement(parser);
+    if (match(parser, T_ELSE)) node->c = scopedStatement(parser);
+    return node;
 }
 
-static void printStatement() {
-    expression();
-    consume(T_SEMICOLON, "`;` expected after value.");
-    emitByte(OP_PUTS);
+static Node *printStatement(Parser *parser) {
+    Node *node = makeNode(parser, N_PUTS);
+    node->a = expression(parser);
+    consume(parser, T_SEMICOLON, "`;` expected after value.");
+    return node;
 }
 
-static void whileStatement() {
-    int loopStart = currentChunk()->count;
-    consume(T_LPAREN, "`(` expected after `while`");
-    expression();
-    consume(T_RPAREN, "`)` expected after condition");
+static Node *returnStatement(Parser *parser) {
+    Node *node = makeNode(parser, N_RETURN);
+    if (parser->compiler->function == NULL) {
+        error(parser, "Cannot return from top-level code.");
+    }
+    if (match(parser, T_SEMICOLON)) return node;
+    node->a = expression(parser);
+    consume(parser, T_SEMICOLON, "`;` expected after return value.");
+    return node;
+}
 
-    int exitJump = emitJump(OP_JUMP_IF_FALSE);
-    emitByte(OP_POP);
-    statement();
-    emitLoop(loopStart);
-    patchJump(exitJump);
-    emitByte(OP_POP);
+static Node *whileStatement(Parser *parser) {
+    Node *node = makeNode(parser, N_WHILE);
+    consume(parser, T_LPAREN, "`(` expected after `while`");
+    node->a = expression(parser);
+    consume(parser, T_RPAREN, "`)` expected after condition");
+    node->b = scopedStatement(parser);
+    return node;
 }
 
-static void synchronize() {
-    parser.panicMode = false;
+static void synchronize(Parser *parser) {
+    parser->panicMode = false;
 
-    while (parser.current.type != T_EOF) {
-        if (parser.previous.type == T_SEMICOLON) return;
+    while (parser->current.type != T_EOF) {
+        if (parser->previous.type == T_SEMICOLON) return;
 
-        switch (parser.current.type) {
+        switch (parser->current.type) {
             case T_CLASS:
             case T_FUN:
             case T_LET:
@@ -595,49 +1100,117 @@ static void synchronize() {
                 return;
             default:;
         }
-        advance();
+        advance(parser);
     }
 }
 
-static void declaration() {
-    if (match(T_LET)) {
-        varDeclaration();
+static Node *declaration(Parser *parser) {
+    Node *node;
+    if (match(parser, T_FUN)) {
+        node = funDeclaration(parser);
+    } else if (match(parser, T_LET)) {
+        node = varDeclaration(parser);
     } else {
-        statement();
+        node = statement(parser);
     }
 
-    if (parser.panicMode) synchronize();
+    if (parser->panicMode) synchronize(parser);
+    return node;
 }
 
-static void statement() {
-    if (match(T_PUTS)) {
-        printStatement();
-    } else if (match(T_FOR)) {
-        forStatement();
-    } else if (match(T_IF)) {
-        ifStatement();
-    } else if (match(T_WHILE)) {
-        whileStatement();
-    } else if (match(T_LBRACE)) {
-        beginScope();
-        block();
-        endScope();
+static Node *statement(Parser *parser) {
+    if (match(parser, T_PUTS)) {
+        return printStatement(parser);
+    } else if (match(parser, T_FOR)) {
+        return forStatement(parser);
+    } else if (match(parser, T_IF)) {
+        return ifStatement(parser);
+    } else if (match(parser, T_RETURN)) {
+        return returnStatement(parser);
+    } else if (match(parser, T_WHILE)) {
+        return whileStatement(parser);
+    } else if (match(parser, T_LBRACE)) {
+        beginScope(parser);
+        Node *node = makeBlock(parser);
+        block(parser, node);
+        endScope(parser);
+        return node;
     } else {
-        expressionStatement();
+        return expressionStatement(parser);
+    }
+}
+
+static void initParser(Parser *parser, VM *vm, CompileState *state, const char *source, Chunk *chunk) {
+    parser->vm = vm;
+    initScanner(&parser->scanner, source);
+    parser->scanner.line = state->line;
+    parser->compiler = NULL;
+    parser->chunk = chunk;
+    parser->expr = NULL;
+    parser->line = state->line;
+    parser->state = state;
+    parser->hadError = false;
+    parser->panicMode = false;
+}
+
+void initCompileState(CompileState *state) {
+    initTable(&state->defined);
+    state->line = 1;
+    state->functionCount = 0;
+}
+
+void freeCompileState(VM *vm, CompileState *state) {
+    freeTable(vm, &state->defined);
+    initCompileState(state);
+}
+
+bool compileNext(VM *vm, CompileState *state, const char *source, Chunk *chunk) {
+    Parser parser;
+    initParser(&parser, vm, state, source, chunk);
+    Ir ir;
+    initIr(&ir);
+    Compiler compiler;
+    initCompiler(&parser, &compiler, NULL, &ir);
+    advance(&parser);
+    // Each top-level declaration is a tree of its own, emitted before the
+    // next one is parsed. The block around it pops any locals the
+    // optimizer adds.
+    while (!match(&parser, T_EOF)) {
+        Node *root = makeBlock(&parser);
+        Node *item = declaration(&parser);
+        addItem(root, item);
+        emitTree(&parser, root);
+        if (item->kind == N_DEFINE_GLOBAL) tableSet(vm, &state->defined, item->name, NULL_VAL);
+        freeIr(&ir);
     }
+    endCompiler(&parser);
+    state->line = parser.scanner.line;
+    return !parser.hadError;
 }
 
-bool compile(const char *source, Chunk *chunk) {
-    initScanner(source);
+bool compile(VM *vm, const char *source, Chunk *chunk) {
+    CompileState state;
+    initCompileState(&state);
+    bool compiled = compileNext(vm, &state, source, chunk);
+    freeCompileState(vm, &state);
+    return compiled;
+}
+
+bool compileExpression(VM *vm, const char *source, Chunk *chunk) {
+    CompileState state;
+    initCompileState(&state);
+    Parser parser;
+    initParser(&parser, vm, &state, source, chunk);
+    Ir ir;
+    initIr(&ir);
     Compiler compiler;
-    initCompiler(&compiler);
-    compilingChunk = chunk;
-    parser.hadError = false;
-    parser.panicMode = false;
-    advance();
-    while (!match(T_EOF)) {
-        declaration();
-    }
-    endCompiler();
+    initCompiler(&parser, &compiler, NULL, &ir);
+    advance(&parser);
+    Node *root = expression(&parser);
+    consume(&parser, T_EOF, "End of expression expected.");
+    emitTree(&parser, root);
+    freeIr(&ir);
+    endCompiler(&parser);
+    freeCompileState(vm, &state);
     return !parser.hadError;
-}
\ No newline at end of file
+}
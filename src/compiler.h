@@ -7,6 +7,30 @@
 
 #include "vm.h"
 
-bool compile(const char *source, Chunk *chunk);
+bool compile(VM *vm, const char *source, Chunk *chunk);
+
+// What the compiler carries from one part of a script to the next when the
+// script is compiled a piece at a time.
+typedef struct {
+    // Globals defined by the top-level declarations compiled so far.
+    Table defined;
+    // The line the next part starts on.
+    int line;
+    // Functions compiled so far, which numbers the next one.
+    int functionCount;
+} CompileState;
+
+void initCompileState(CompileState *state);
+
+void freeCompileState(VM *vm, CompileState *state);
+
+// Compiles the next part of a script, made of whole top-level declarations,
+// into `chunk`. The parts before it must have been compiled with the same
+// `state` and have run before this one does.
+bool compileNext(VM *vm, CompileState *state, const char *source, Chunk *chunk);
+
+// Compiles a single expression whose value is left on top of the stack
+// when the chunk returns.
+bool compileExpression(VM *vm, const char *source, Chunk *chunk);
 
 #endif //CSCRIPTY_COMPILER_H
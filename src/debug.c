@@ -4,100 +4,205 @@
 
 #include <stdio.h>
 #include "debug.h"
+#include "vm.h"
 
-void disassembleChunk(Chunk *chunk, const char *name) {
-    printf("== %s ==\n", name);
+static const char *const opNames[] = {
+        [OP_CONSTANT]      = "cst",
+        [OP_NULL]          = "nul",
+        [OP_TRUE]          = "true",
+        [OP_FALSE]         = "false",
+        [OP_POP]           = "pop",
+        [OP_GET_LOCAL]     = "gl",
+        [OP_SET_LOCAL]     = "sl",
+        [OP_GET_GLOBAL]    = "gg",
+        [OP_DEFINE_GLOBAL] = "dg",
+        [OP_SET_GLOBAL]    = "sg",
+        [OP_EQUAL]         = "eql",
+        [OP_GREATER]       = "cmpg",
+        [OP_LESS]          = "cmpl",
+        [OP_ADD]           = "add",
+        [OP_SUB]           = "sub",
+        [OP_MUL]           = "mul",
+        [OP_DIV]           = "div",
+        [OP_NOT]           = "not",
+        [OP_NEGATE]        = "neg",
+        [OP_PUTS]          = "puts",
+        [OP_JUMP]          = "jmp",
+        [OP_JUMP_IF_FALSE] = "jmpf",
+        [OP_LOOP]          = "goto",
+        [OP_BUILD_LIST]    = "lst",
+        [OP_INDEX_GET]     = "geti",
+        [OP_INDEX_SET]     = "seti",
+        [OP_LENGTH]        = "len",
+        [OP_APPEND]        = "app",
+        [OP_BUILD_MAP]     = "map",
+        [OP_HAS]           = "has",
+        [OP_REMOVE]        = "rem",
+        [OP_FLOAT64]       = "f64",
+        [OP_SUM]           = "sum",
+        [OP_MIN]           = "min",
+        [OP_MAX]           = "max",
+        [OP_DOT]           = "dot",
+        [OP_SCALE]         = "scale",
+        [OP_ARRAY_ADD]     = "eadd",
+        [OP_ARRAY_MUL]     = "emul",
+        [OP_CALL]          = "call",
+        [OP_TAIL_CALL]     = "tcall",
+        [OP_ADD_NN]        = "add.nn",
+        [OP_SUB_NN]        = "sub.nn",
+        [OP_MUL_NN]        = "mul.nn",
+        [OP_DIV_NN]        = "div.nn",
+        [OP_LESS_NN]       = "cmpl.nn",
+        [OP_GREATER_NN]    = "cmpg.nn",
+        [OP_NEGATE_NN]     = "neg.nn",
+        [OP_CALL_NN]       = "call.nn",
+        [OP_RETURN]        = "ret",
+};
+
+const char *opName(uint8_t instruction) {
+    if (instruction >= sizeof(opNames) / sizeof(opNames[0]) || opNames[instruction] == NULL) return "???";
+    return opNames[instruction];
+}
+
+void disassembleChunk(VM *vm, Chunk *chunk, const char *name) {
+    fprintf(vm->out, "== %s ==\n", name);
 
     for (int offset = 0; offset < chunk->count;) {
-        offset = disassembleInstruction(chunk, offset);
+        offset = disassembleInstruction(vm, chunk, offset);
     }
 }
 
-static int constantInstruction(const char *name, Chunk *chunk, int offset) {
+static int constantInstruction(VM *vm, const char *name, Chunk *chunk, int offset) {
     uint8_t constant = chunk->code[offset + 1];
-    printf("%-16s %4d '", name, constant);
-    printValue(chunk->constants.values[constant]);
-    printf("'\n");
+    fprintf(vm->out, "%-16s %4d '", name, constant);
+    printValue(vm, chunk->constants.values[constant]);
+    fprintf(vm->out, "'\n");
     return offset + 2;
 }
 
-static int simpleInstruction(const char *name, int offset) {
-    printf("%s\n", name);
+static int simpleInstruction(VM *vm, const char *name, int offset) {
+    fprintf(vm->out, "%s\n", name);
     return offset + 1;
 }
 
-static int byteInstruction(const char *name, Chunk *chunk, int offset) {
+static int byteInstruction(VM *vm, const char *name, Chunk *chunk, int offset) {
     uint8_t slot = chunk->code[offset + 1];
-    printf("%-16s %4d\n", name, slot);
+    fprintf(vm->out, "%-16s %4d\n", name, slot);
     return offset + 2;
 }
 
-static int jumpInstruction(const char *name, int sign, Chunk *chunk, int offset) {
+static int jumpInstruction(VM *vm, const char *name, int sign, Chunk *chunk, int offset) {
     uint16_t jump = (uint16_t) (chunk->code[offset + 1] << 8);
     jump |= chunk->code[offset + 2];
-    printf("%-16s %4d -> %d\n", name, offset, offset + 3 + sign * jump);
+    fprintf(vm->out, "%-16s %4d -> %d\n", name, offset, offset + 3 + sign * jump);
     return offset + 3;
 }
 
-int disassembleInstruction(Chunk *chunk, int offset) {
-    printf("%04d ", offset);
+int disassembleInstruction(VM *vm, Chunk *chunk, int offset) {
+    fprintf(vm->out, "%04d ", offset);
     if (offset > 0 && chunk->lines[offset] == chunk->lines[offset - 1]) {
-        printf("   | ");
+        fprintf(vm->out, "   | ");
     } else {
-        printf("%4d ", chunk->lines[offset]);
+        fprintf(vm->out, "%4d ", chunk->lines[offset]);
     }
     uint8_t instruction = chunk->code[offset];
     switch (instruction) {
         case OP_CONSTANT:
-            return constantInstruction("cst", chunk, offset);
+            return constantInstruction(vm, "cst", chunk, offset);
         case OP_ADD:
-            return simpleInstruction("add", offset);
+            return simpleInstruction(vm, "add", offset);
         case OP_SUB:
-            return simpleInstruction("sub", offset);
+            return simpleInstruction(vm, "sub", offset);
         case OP_MUL:
-            return simpleInstruction("mul", offset);
+            return simpleInstruction(vm, "mul", offset);
         case OP_DIV:
-            return simpleInstruction("div", offset);
+            return simpleInstruction(vm, "div", offset);
         case OP_NOT:
-            return simpleInstruction("not", offset);
+            return simpleInstruction(vm, "not", offset);
         case OP_NEGATE:
-            return simpleInstruction("neg", offset);
+            return simpleInstruction(vm, "neg", offset);
         case OP_PUTS:
-            return simpleInstruction("puts", offset);
+            return simpleInstruction(vm, "puts", offset);
         case OP_JUMP:
-            return jumpInstruction("jmp", 1, chunk, offset);
+            return jumpInstruction(vm, "jmp", 1, chunk, offset);
         case OP_JUMP_IF_FALSE:
-            return jumpInstruction("jmpf", 1, chunk, offset);
+            return jumpInstruction(vm, "jmpf", 1, chunk, offset);
         case OP_LOOP:
-            return jumpInstruction("goto", -1, chunk, offset);
+            return jumpInstruction(vm, "goto", -1, chunk, offset);
+        case OP_BUILD_LIST:
+            return byteInstruction(vm, "lst", chunk, offset);
+        case OP_INDEX_GET:
+            return simpleInstruction(vm, "geti", offset);
+        case OP_INDEX_SET:
+            return simpleInstruction(vm, "seti", offset);
+        case OP_LENGTH:
+            return simpleInstruction(vm, "len", offset);
+        case OP_APPEND:
+            return simpleInstruction(vm, "app", offset);
+        case OP_BUILD_MAP:
+            return byteInstruction(vm, "map", chunk, offset);
+        case OP_HAS:
+            return simpleInstruction(vm, "has", offset);
+        case OP_REMOVE:
+            return simpleInstruction(vm, "rem", offset);
+        case OP_FLOAT64:
+            return simpleInstruction(vm, "f64", offset);
+        case OP_SUM:
+            return simpleInstruction(vm, "sum", offset);
+        case OP_MIN:
+            return simpleInstruction(vm, "min", offset);
+        case OP_MAX:
+            return simpleInstruction(vm, "max", offset);
+        case OP_DOT:
+            return simpleInstruction(vm, "dot", offset);
+        case OP_SCALE:
+            return simpleInstruction(vm, "scale", offset);
+        case OP_ARRAY_ADD:
+            return simpleInstruction(vm, "eadd", offset);
+        case OP_ARRAY_MUL:
+            return simpleInstruction(vm, "emul", offset);
+        case OP_CALL:
+            return byteInstruction(vm, "call", chunk, offset);
+        case OP_TAIL_CALL:
+            return byteInstruction(vm, "tcall", chunk, offset);
+        case OP_ADD_NN:
+        case OP_SUB_NN:
+        case OP_MUL_NN:
+        case OP_DIV_NN:
+        case OP_LESS_NN:
+        case OP_GREATER_NN:
+        case OP_NEGATE_NN:
+            return simpleInstruction(vm, opName(instruction), offset);
+        case OP_CALL_NN:
+            return byteInstruction(vm, "call.nn", chunk, offset);
         case OP_RETURN:
-            return simpleInstruction("ret", offset);
+            return simpleInstruction(vm, "ret", offset);
         case OP_NULL:
-            return simpleInstruction("nul", offset);
+            return simpleInstruction(vm, "nul", offset);
         case OP_TRUE:
-            return simpleInstruction("true", offset);
+            return simpleInstruction(vm, "true", offset);
         case OP_FALSE:
-            return simpleInstruction("false", offset);
+            return simpleInstruction(vm, "false", offset);
         case OP_POP:
-            return simpleInstruction("pop", offset);
+            return simpleInstruction(vm, "pop", offset);
         case OP_GET_LOCAL:
-            return byteInstruction("gl", chunk, offset);
+            return byteInstruction(vm, "gl", chunk, offset);
         case OP_SET_LOCAL:
-            return byteInstruction("sl", chunk, offset);
+            return byteInstruction(vm, "sl", chunk, offset);
         case OP_GET_GLOBAL:
-            return constantInstruction("gg", chunk, offset);
+            return constantInstruction(vm, "gg", chunk, offset);
         case OP_DEFINE_GLOBAL:
-            return constantInstruction("dg", chunk, offset);
+            return constantInstruction(vm, "dg", chunk, offset);
         case OP_SET_GLOBAL:
-            return constantInstruction("sg", chunk, offset);
+            return constantInstruction(vm, "sg", chunk, offset);
         case OP_EQUAL:
-            return simpleInstruction("eql", offset);
+            return simpleInstruction(vm, "eql", offset);
         case OP_GREATER:
-            return simpleInstruction("cmpg", offset);
+            return simpleInstruction(vm, "cmpg", offset);
         case OP_LESS:
-            return simpleInstruction("cmpl", offset);
+            return simpleInstruction(vm, "cmpl", offset);
         default: {
-            printf("Unknown opcode %d\n", instruction);
+            fprintf(vm->out, "Unknown opcode %d\n", instruction);
             return offset + 1;
         }
     }
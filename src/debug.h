@@ -7,8 +7,10 @@
 
 #include "chunk.h"
 
-void disassembleChunk(Chunk *chunk, const char *name);
+void disassembleChunk(VM *vm, Chunk *chunk, const char *name);
 
-int disassembleInstruction(Chunk *chunk, int offset);
+int disassembleInstruction(VM *vm, Chunk *chunk, int offset);
+
+const char *opName(uint8_t instruction);
 
 #endif //CSCRIPTY_DEBUG_H
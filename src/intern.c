@@ -0,0 +1,177 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+
+#define SHARD_BITS 4
+#define SHARD_COUNT (1 << SHARD_BITS)
+#define SHARD_MIN_CAPACITY 64
+
+// Slots are only ever filled, never cleared, so a reader holding an old
+// array still sees a consistent (if stale) view. Replaced arrays are kept
+// on the retired list until freeSharedStrings.
+typedef struct SlotArray {
+    struct SlotArray *retired;
+    uint32_t capacity;
+    _Atomic(ObjString *) slots[];
+} SlotArray;
+
+typedef struct {
+    pthread_mutex_t lock;
+    _Atomic(SlotArray *) array;
+    uint32_t count;
+    // Memory held by the shard, for sharedStringStats.
+    size_t stringBytes;
+    size_t tableBytes;
+} Shard;
+
+static Shard shards[SHARD_COUNT];
+static pthread_once_t shardsOnce = PTHREAD_ONCE_INIT;
+
+static void initShards() {
+    for (int i = 0; i < SHARD_COUNT; i++) {
+        pthread_mutex_init(&shards[i].lock, NULL);
+    }
+}
+
+static Shard *shardFor(uint32_t hash) {
+    return &shards[hash >> (32 - SHARD_BITS)];
+}
+
+static ObjString *findInArray(SlotArray *array, const char *chars, int length, uint32_t hash) {
+    if (array == NULL) return NULL;
+    uint32_t mask = array->capacity - 1;
+    for (uint32_t index = hash & mask;; index = (index + 1) & mask) {
+        ObjString *string = atomic_load_explicit(&array->slots[index], memory_order_acquire);
+        if (string == NULL) return NULL;
+        if (string->length == length &&
+            string->hash == hash &&
+            memcmp(string->chars, chars, length) == 0) {
+            return string;
+        }
+    }
+}
+
+static void storeInArray(SlotArray *array, ObjString *string) {
+    uint32_t mask = array->capacity - 1;
+    for (uint32_t index = string->hash & mask;; index = (index + 1) & mask) {
+        if (atomic_load_explicit(&array->slots[index], memory_order_relaxed) == NULL) {
+            atomic_store_explicit(&array->slots[index], string, memory_order_release);
+            return;
+        }
+    }
+}
+
+static size_t arraySize(uint32_t capacity) {
+    return sizeof(SlotArray) + sizeof(_Atomic(ObjString *)) * capacity;
+}
+
+static SlotArray *newArray(uint32_t capacity) {
+    SlotArray *array = malloc(arraySize(capacity));
+    if (array == NULL) exit(1);
+    array->retired = NULL;
+    array->capacity = capacity;
+    for (uint32_t i = 0; i < capacity; i++) {
+        atomic_init(&array->slots[i], NULL);
+    }
+    return array;
+}
+
+static ObjString *newSharedString(const char *chars, int length, uint32_t hash) {
+    ObjString *string = malloc(sizeof(ObjString));
+    char *heapChars = malloc(length + 1);
+    if (string == NULL || heapChars == NULL) exit(1);
+    memcpy(heapChars, chars, length);
+    heapChars[length] = '\0';
+    string->obj.type = O_STRING;
+    string->obj.next = NULL;
+    string->length = length;
+    string->chars = heapChars;
+    string->hash = hash;
+    string->interned = true;
+    return string;
+}
+
+ObjString *findSharedString(const char *chars, int length, uint32_t hash) {
+    SlotArray *array = atomic_load_explicit(&shardFor(hash)->array, memory_order_acquire);
+    return findInArray(array, chars, length, hash);
+}
+
+ObjString *internSharedString(const char *chars, int length, uint32_t hash) {
+    ObjString *string = findSharedString(chars, length, hash);
+    if (string != NULL) return string;
+
+    pthread_once(&shardsOnce, initShards);
+    Shard *shard = shardFor(hash);
+    pthread_mutex_lock(&shard->lock);
+
+    SlotArray *array = atomic_load_explicit(&shard->array, memory_order_relaxed);
+    string = findInArray(array, chars, length, hash);
+    if (string == NULL) {
+        // Keep the load factor at or below one half so probes stay short.
+        if (array == NULL || (shard->count + 1) * 2 > array->capacity) {
+            SlotArray *grown = newArray(array == NULL ? SHARD_MIN_CAPACITY : array->capacity * 2);
+            if (array != NULL) {
+                for (uint32_t i = 0; i < array->capacity; i++) {
+                    ObjString *entry = atomic_load_explicit(&array->slots[i], memory_order_relaxed);
+                    if (entry != NULL) storeInArray(grown, entry);
+                }
+                grown->retired = array;
+            }
+            atomic_store_explicit(&shard->array, grown, memory_order_release);
+            shard->tableBytes += arraySize(grown->capacity);
+            array = grown;
+        }
+        string = newSharedString(chars, length, hash);
+        storeInArray(array, string);
+        shard->count++;
+        shard->stringBytes += sizeof(ObjString) + length + 1;
+    }
+
+    pthread_mutex_unlock(&shard->lock);
+    return string;
+}
+
+void sharedStringStats(SharedStringStats *stats) {
+    memset(stats, 0, sizeof(SharedStringStats));
+    pthread_once(&shardsOnce, initShards);
+    for (int i = 0; i < SHARD_COUNT; i++) {
+        Shard *shard = &shards[i];
+        pthread_mutex_lock(&shard->lock);
+        SlotArray *array = atomic_load_explicit(&shard->array, memory_order_relaxed);
+        stats->strings += shard->count;
+        stats->stringBytes += shard->stringBytes;
+        stats->tableBytes += shard->tableBytes;
+        stats->slots += array == NULL ? 0 : array->capacity;
+        if (shard->count > stats->fullestShard) stats->fullestShard = shard->count;
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+void freeSharedStrings() {
+    for (int i = 0; i < SHARD_COUNT; i++) {
+        Shard *shard = &shards[i];
+        SlotArray *array = atomic_load_explicit(&shard->array, memory_order_relaxed);
+        if (array == NULL) continue;
+        for (uint32_t j = 0; j < array->capacity; j++) {
+            ObjString *string = atomic_load_explicit(&array->slots[j], memory_order_relaxed);
+            if (string == NULL) continue;
+            free(string->chars);
+            free(string);
+        }
+        while (array != NULL) {
+            SlotArray *retired = array->retired;
+            free(array);
+            array = retired;
+        }
+        atomic_store_explicit(&shard->array, NULL, memory_order_relaxed);
+        shard->count = 0;
+        shard->stringBytes = 0;
+        shard->tableBytes = 0;
+    }
+}
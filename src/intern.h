@@ -0,0 +1,34 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#ifndef CSCRIPTY_INTERN_H
+#define CSCRIPTY_INTERN_H
+
+#include "common.h"
+#include "object.h"
+
+// Process-wide intern table for strings that live as long as the process
+// (literals and identifiers). Lookups never lock; inserts lock one of a
+// fixed set of shards. Strings stored here are not owned by any VM.
+ObjString *findSharedString(const char *chars, int length, uint32_t hash);
+
+ObjString *internSharedString(const char *chars, int length, uint32_t hash);
+
+// Totals of the shared table across its shards, for memory reports.
+typedef struct {
+    uint32_t strings;
+    // The strings and their characters.
+    size_t stringBytes;
+    // Slot arrays, including the ones retired by growth.
+    size_t tableBytes;
+    uint32_t slots;
+    // The most strings any one shard holds.
+    uint32_t fullestShard;
+} SharedStringStats;
+
+void sharedStringStats(SharedStringStats *stats);
+
+void freeSharedStrings();
+
+#endif //CSCRIPTY_INTERN_H
@@ -0,0 +1,267 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "ir.h"
+#include "scanner.h"
+
+void initIr(Ir *ir) {
+    ir->nodes = NULL;
+    ir->vars = NULL;
+    ir->varCount = 0;
+    ir->varCapacity = 0;
+    ir->paramCount = 0;
+}
+
+void freeIr(Ir *ir) {
+    Node *node = ir->nodes;
+    while (node != NULL) {
+        Node *next = node->allNext;
+        free(node->items);
+        free(node);
+        node = next;
+    }
+    free(ir->vars);
+    initIr(ir);
+}
+
+Node *newNode(Ir *ir, NodeKind kind, int line) {
+    Node *node = calloc(1, sizeof(Node));
+    if (node == NULL) exit(1);
+    node->kind = kind;
+    node->line = line;
+    node->type = TYPE_ANY;
+    node->value = NULL_VAL;
+    node->allNext = ir->nodes;
+    ir->nodes = node;
+    return node;
+}
+
+Node *newConstant(Ir *ir, Value value, int line) {
+    Node *node = newNode(ir, N_CONSTANT, line);
+    node->value = value;
+    node->type = constantType(value);
+    return node;
+}
+
+static void reserveItems(Node *node, int count) {
+    if (count <= node->capacity) return;
+    node->capacity = node->capacity < 4 ? 4 : node->capacity * 2;
+    if (node->capacity < count) node->capacity = count;
+    node->items = realloc(node->items, sizeof(Node *) * node->capacity);
+    if (node->items == NULL) exit(1);
+}
+
+void addItem(Node *node, Node *item) {
+    reserveItems(node, node->count + 1);
+    node->items[node->count++] = item;
+}
+
+void insertItem(Node *node, int index, Node *item) {
+    reserveItems(node, node->count + 1);
+    memmove(node->items + index + 1, node->items + index, sizeof(Node *) * (node->count - index));
+    node->items[index] = item;
+    node->count++;
+}
+
+void removeItem(Node *node, int index) {
+    memmove(node->items + index, node->items + index + 1, sizeof(Node *) * (node->count - index - 1));
+    node->count--;
+}
+
+Node *cloneNode(Ir *ir, Node *node) {
+    if (node == NULL) return NULL;
+    Node *copy = newNode(ir, node->kind, node->line);
+    Node *allNext = copy->allNext;
+    *copy = *node;
+    copy->allNext = allNext;
+    copy->items = NULL;
+    copy->count = 0;
+    copy->capacity = 0;
+    copy->a = cloneNode(ir, node->a);
+    copy->b = cloneNode(ir, node->b);
+    copy->c = cloneNode(ir, node->c);
+    for (int i = 0; i < node->count; i++) addItem(copy, cloneNode(ir, node->items[i]));
+    return copy;
+}
+
+int newVar(Ir *ir, bool hidden) {
+    if (ir->varCount == ir->varCapacity) {
+        ir->varCapacity = ir->varCapacity < 8 ? 8 : ir->varCapacity * 2;
+        ir->vars = realloc(ir->vars, sizeof(IrVar) * ir->varCapacity);
+        if (ir->vars == NULL) exit(1);
+    }
+    IrVar *var = &ir->vars[ir->varCount];
+    var->slot = -1;
+    var->hidden = hidden;
+    return ir->varCount++;
+}
+
+StaticType constantType(Value value) {
+    if (IS_NUMERIC(value)) return TYPE_NUMBER;
+    if (IS_BOOL(value)) return TYPE_BOOL;
+    return TYPE_ANY;
+}
+
+// The type of every local at the point being walked.
+typedef struct {
+    StaticType *types;
+    int count;
+} Inference;
+
+static StaticType joinType(StaticType a, StaticType b) {
+    return a == b ? a : TYPE_ANY;
+}
+
+static StaticType *saveTypes(Inference *inference) {
+    StaticType *saved = malloc(sizeof(StaticType) * (inference->count + 1));
+    if (saved == NULL) exit(1);
+    memcpy(saved, inference->types, sizeof(StaticType) * inference->count);
+    return saved;
+}
+
+// Where control flow from `other` meets `into`, a local keeps its type only
+// if both paths agree. Returns true if any type in `into` widened.
+static bool joinTypes(StaticType *into, const StaticType *other, int count) {
+    bool widened = false;
+    for (int i = 0; i < count; i++) {
+        StaticType joined = joinType(into[i], other[i]);
+        if (joined != into[i]) widened = true;
+        into[i] = joined;
+    }
+    return widened;
+}
+
+static void infer(Inference *inference, Node *node) {
+    switch (node->kind) {
+        case N_CONSTANT:
+            node->type = constantType(node->value);
+            break;
+        case N_GET_LOCAL:
+            node->type = inference->types[node->var];
+            break;
+        case N_SET_LOCAL:
+            infer(inference, node->a);
+            inference->types[node->var] = node->a->type;
+            node->type = node->a->type;
+            break;
+        case N_GET_GLOBAL:
+            node->type = TYPE_ANY;
+            break;
+        case N_SET_GLOBAL:
+            infer(inference, node->a);
+            node->type = node->a->type;
+            break;
+        case N_BINARY:
+            infer(inference, node->a);
+            infer(inference, node->b);
+            switch (node->op) {
+                case T_EQ:
+                case T_NE:
+                case T_GT:
+                case T_GTE:
+                case T_LT:
+                case T_LTE:
+                    node->type = TYPE_BOOL;
+                    break;
+                case T_PLUS:
+                    // `+` also joins strings.
+                    node->type = node->a->type == TYPE_NUMBER && node->b->type == TYPE_NUMBER
+                                 ? TYPE_NUMBER : TYPE_ANY;
+                    break;
+                default:
+                    // The other operators only succeed on numbers.
+                    node->type = TYPE_NUMBER;
+                    break;
+            }
+            break;
+        case N_UNARY:
+            infer(inference, node->a);
+            node->type = node->op == T_BANG ? TYPE_BOOL : TYPE_NUMBER;
+            break;
+        case N_AND:
+        case N_OR: {
+            infer(inference, node->a);
+            StaticType *skipped = saveTypes(inference);
+            infer(inference, node->b);
+            joinTypes(inference->types, skipped, inference->count);
+            free(skipped);
+            node->type = joinType(node->a->type, node->b->type);
+            break;
+        }
+        case N_LIST:
+        case N_MAP:
+        case N_CALL:
+        case N_INDEX_GET:
+        case N_METHOD:
+        case N_INDEX_SET:
+            if (node->a != NULL) infer(inference, node->a);
+            if (node->b != NULL) infer(inference, node->b);
+            if (node->c != NULL) infer(inference, node->c);
+            for (int i = 0; i < node->count; i++) infer(inference, node->items[i]);
+            if (node->kind == N_INDEX_SET) {
+                // Assignments leave the assigned value.
+                node->type = node->c->type;
+            } else if (node->kind != N_METHOD) {
+                node->type = TYPE_ANY;
+            }
+            break;
+        case N_EXPRESSION:
+        case N_PUTS:
+        case N_DEFINE_GLOBAL:
+            infer(inference, node->a);
+            break;
+        case N_LET:
+            infer(inference, node->a);
+            inference->types[node->var] = node->a->type;
+            break;
+        case N_BLOCK:
+            for (int i = 0; i < node->count; i++) infer(inference, node->items[i]);
+            break;
+        case N_IF: {
+            infer(inference, node->a);
+            StaticType *before = saveTypes(inference);
+            infer(inference, node->b);
+            StaticType *afterThen = saveTypes(inference);
+            memcpy(inference->types, before, sizeof(StaticType) * inference->count);
+            if (node->c != NULL) infer(inference, node->c);
+            joinTypes(inference->types, afterThen, inference->count);
+            free(before);
+            free(afterThen);
+            break;
+        }
+        case N_WHILE: {
+            // The body is walked assuming the types locals have at the head;
+            // if the path back to the head weakens one, it is walked again
+            // under the weaker assumption. Types only ever widen to
+            // TYPE_ANY, so this settles after a pass or two.
+            StaticType *head = saveTypes(inference);
+            StaticType *exitTypes = NULL;
+            do {
+                memcpy(inference->types, head, sizeof(StaticType) * inference->count);
+                infer(inference, node->a);
+                free(exitTypes);
+                exitTypes = saveTypes(inference);
+                infer(inference, node->b);
+            } while (joinTypes(head, inference->types, inference->count));
+            memcpy(inference->types, exitTypes, sizeof(StaticType) * inference->count);
+            free(head);
+            free(exitTypes);
+            break;
+        }
+        case N_RETURN:
+            if (node->a != NULL) infer(inference, node->a);
+            break;
+    }
+}
+
+void inferTypes(Ir *ir, Node *root) {
+    Inference inference;
+    inference.count = ir->varCount;
+    inference.types = calloc(ir->varCount + 1, sizeof(StaticType));
+    if (inference.types == NULL) exit(1);
+    infer(&inference, root);
+    free(inference.types);
+}
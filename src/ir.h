@@ -0,0 +1,122 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#ifndef CSCRIPTY_IR_H
+#define CSCRIPTY_IR_H
+
+#include "common.h"
+#include "value.h"
+#include "object.h"
+
+// The tree the compiler parses each function, and each top-level
+// declaration of a script, into before any bytecode is written. The
+// optimizer rewrites it in place and the compiler then emits it.
+
+// What the compiler can prove about a value. Numbers cover both ints and
+// doubles, which the unchecked opcodes still tell apart at runtime.
+typedef enum {
+    TYPE_ANY,
+    TYPE_NUMBER,
+    TYPE_BOOL
+} StaticType;
+
+typedef enum {
+    // Expressions.
+    N_CONSTANT,      // value
+    N_GET_LOCAL,     // var
+    N_SET_LOCAL,     // var = a
+    N_GET_GLOBAL,    // name
+    N_SET_GLOBAL,    // name = a
+    N_BINARY,        // a op b, with op a TokenType
+    N_UNARY,         // op a
+    N_AND,           // a and b
+    N_OR,            // a or b
+    N_LIST,          // [items]
+    N_MAP,           // {items}, keys and values alternating
+    N_CALL,          // a(items)
+    N_INDEX_GET,     // a[b]
+    N_INDEX_SET,     // a[b] = c
+    N_METHOD,        // a.op(items), with op an OpCode
+    // Statements.
+    N_EXPRESSION,    // a;
+    N_PUTS,          // puts a;
+    N_LET,           // let var = a; for a local
+    N_DEFINE_GLOBAL, // let name = a; at the top level
+    N_BLOCK,         // { items }
+    N_IF,            // if (a) b else c, where c may be NULL
+    N_WHILE,         // while (a) b
+    N_RETURN,        // return a; where a may be NULL
+} NodeKind;
+
+typedef struct Node Node;
+
+struct Node {
+    NodeKind kind;
+    int line;
+    // Filled in by inferTypes() for expressions. Methods keep the type the
+    // parser gave them.
+    StaticType type;
+    int op;
+    int var;
+    ObjString *name;
+    Value value;
+    Node *a;
+    Node *b;
+    Node *c;
+    Node **items;
+    int count;
+    int capacity;
+    // A block pops the locals declared in it when it ends, unless it is the
+    // body of a function, whose frame is discarded on return.
+    bool pops;
+    // Every node of an Ir, for freeIr().
+    Node *allNext;
+};
+
+// A local variable. Parsing and optimizing refer to locals by index into
+// Ir.vars; stack slots are only handed out as the tree is emitted, so the
+// optimizer is free to add and remove locals.
+typedef struct {
+    int slot;
+    // Added by the optimizer rather than declared in the source.
+    bool hidden;
+} IrVar;
+
+typedef struct {
+    Node *nodes;
+    IrVar *vars;
+    int varCount;
+    int varCapacity;
+    // Locals that are live on entry: the callee and the parameters of a
+    // function, in slot order.
+    int paramCount;
+} Ir;
+
+void initIr(Ir *ir);
+
+void freeIr(Ir *ir);
+
+Node *newNode(Ir *ir, NodeKind kind, int line);
+
+Node *newConstant(Ir *ir, Value value, int line);
+
+// Appends `item` to a node's items.
+void addItem(Node *node, Node *item);
+
+// Inserts `item` into a node's items before index `index`.
+void insertItem(Node *node, int index, Node *item);
+
+void removeItem(Node *node, int index);
+
+Node *cloneNode(Ir *ir, Node *node);
+
+int newVar(Ir *ir, bool hidden);
+
+StaticType constantType(Value value);
+
+// Sets the type of every expression in the tree from the local types that
+// reach it. Loops are walked until the types at their head stop changing.
+void inferTypes(Ir *ir, Node *root);
+
+#endif //CSCRIPTY_IR_H
@@ -0,0 +1,299 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#include <pthread.h>
+#include "kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KERNELS_X86
+#endif
+
+typedef struct {
+    const char *isa;
+    double (*sum)(const double *values, int count);
+    double (*min)(const double *values, int count);
+    double (*max)(const double *values, int count);
+    double (*dot)(const double *a, const double *b, int count);
+    void (*scale)(double *out, const double *values, double factor, int count);
+    void (*add)(double *out, const double *a, const double *b, int count);
+    void (*mul)(double *out, const double *a, const double *b, int count);
+} Kernels;
+
+// The scalar versions double as the tail loops of the vector ones, so each
+// takes the index to start from.
+
+static double sumFrom(const double *values, int i, int count, double sum) {
+    for (; i < count; i++) sum += values[i];
+    return sum;
+}
+
+static double minFrom(const double *values, int i, int count, double min) {
+    for (; i < count; i++) min = values[i] < min ? values[i] : min;
+    return min;
+}
+
+static double maxFrom(const double *values, int i, int count, double max) {
+    for (; i < count; i++) max = values[i] > max ? values[i] : max;
+    return max;
+}
+
+static double dotFrom(const double *a, const double *b, int i, int count, double sum) {
+    for (; i < count; i++) sum += a[i] * b[i];
+    return sum;
+}
+
+static void scaleFrom(double *out, const double *values, double factor, int i, int count) {
+    for (; i < count; i++) out[i] = values[i] * factor;
+}
+
+static void addFrom(double *out, const double *a, const double *b, int i, int count) {
+    for (; i < count; i++) out[i] = a[i] + b[i];
+}
+
+static void mulFrom(double *out, const double *a, const double *b, int i, int count) {
+    for (; i < count; i++) out[i] = a[i] * b[i];
+}
+
+static double sumScalar(const double *values, int count) {
+    return sumFrom(values, 0, count, 0);
+}
+
+static double minScalar(const double *values, int count) {
+    return minFrom(values, 1, count, values[0]);
+}
+
+static double maxScalar(const double *values, int count) {
+    return maxFrom(values, 1, count, values[0]);
+}
+
+static double dotScalar(const double *a, const double *b, int count) {
+    return dotFrom(a, b, 0, count, 0);
+}
+
+static void scaleScalar(double *out, const double *values, double factor, int count) {
+    scaleFrom(out, values, factor, 0, count);
+}
+
+static void addScalar(double *out, const double *a, const double *b, int count) {
+    addFrom(out, a, b, 0, count);
+}
+
+static void mulScalar(double *out, const double *a, const double *b, int count) {
+    mulFrom(out, a, b, 0, count);
+}
+
+static const Kernels scalarKernels = {
+        "scalar", sumScalar, minScalar, maxScalar, dotScalar, scaleScalar, addScalar, mulScalar
+};
+
+#ifdef KERNELS_X86
+
+// Reductions run four independent accumulators so consecutive adds do not
+// wait on each other; a single one would be bound by add latency rather
+// than by memory.
+
+#define SSE2 __attribute__((target("sse2")))
+
+static SSE2 double sumSse2(const double *values, int count) {
+    __m128d acc[4] = {_mm_setzero_pd(), _mm_setzero_pd(), _mm_setzero_pd(), _mm_setzero_pd()};
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        for (int k = 0; k < 4; k++) acc[k] = _mm_add_pd(acc[k], _mm_loadu_pd(values + i + k * 2));
+    }
+    __m128d total = _mm_add_pd(_mm_add_pd(acc[0], acc[1]), _mm_add_pd(acc[2], acc[3]));
+    double lanes[2];
+    _mm_storeu_pd(lanes, total);
+    return sumFrom(values, i, count, lanes[0] + lanes[1]);
+}
+
+static SSE2 double minSse2(const double *values, int count) {
+    if (count < 2) return values[0];
+    __m128d acc = _mm_loadu_pd(values);
+    int i = 2;
+    for (; i + 2 <= count; i += 2) acc = _mm_min_pd(_mm_loadu_pd(values + i), acc);
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    return minFrom(values, i, count, lanes[1] < lanes[0] ? lanes[1] : lanes[0]);
+}
+
+static SSE2 double maxSse2(const double *values, int count) {
+    if (count < 2) return values[0];
+    __m128d acc = _mm_loadu_pd(values);
+    int i = 2;
+    for (; i + 2 <= count; i += 2) acc = _mm_max_pd(_mm_loadu_pd(values + i), acc);
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc);
+    return maxFrom(values, i, count, lanes[1] > lanes[0] ? lanes[1] : lanes[0]);
+}
+
+static SSE2 double dotSse2(const double *a, const double *b, int count) {
+    __m128d acc[4] = {_mm_setzero_pd(), _mm_setzero_pd(), _mm_setzero_pd(), _mm_setzero_pd()};
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        for (int k = 0; k < 4; k++) {
+            __m128d product = _mm_mul_pd(_mm_loadu_pd(a + i + k * 2), _mm_loadu_pd(b + i + k * 2));
+            acc[k] = _mm_add_pd(acc[k], product);
+        }
+    }
+    __m128d total = _mm_add_pd(_mm_add_pd(acc[0], acc[1]), _mm_add_pd(acc[2], acc[3]));
+    double lanes[2];
+    _mm_storeu_pd(lanes, total);
+    return dotFrom(a, b, i, count, lanes[0] + lanes[1]);
+}
+
+static SSE2 void scaleSse2(double *out, const double *values, double factor, int count) {
+    __m128d by = _mm_set1_pd(factor);
+    int i = 0;
+    for (; i + 2 <= count; i += 2) _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(values + i), by));
+    scaleFrom(out, values, factor, i, count);
+}
+
+static SSE2 void addSse2(double *out, const double *a, const double *b, int count) {
+    int i = 0;
+    for (; i + 2 <= count; i += 2) _mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    addFrom(out, a, b, i, count);
+}
+
+static SSE2 void mulSse2(double *out, const double *a, const double *b, int count) {
+    int i = 0;
+    for (; i + 2 <= count; i += 2) _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    mulFrom(out, a, b, i, count);
+}
+
+static const Kernels sse2Kernels = {
+        "sse2", sumSse2, minSse2, maxSse2, dotSse2, scaleSse2, addSse2, mulSse2
+};
+
+#define AVX2 __attribute__((target("avx2")))
+
+static AVX2 double horizontalSum(__m256d v) {
+    __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    double lanes[2];
+    _mm_storeu_pd(lanes, pair);
+    return lanes[0] + lanes[1];
+}
+
+static AVX2 double sumAvx2(const double *values, int count) {
+    __m256d acc[4] = {_mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd()};
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        for (int k = 0; k < 4; k++) acc[k] = _mm256_add_pd(acc[k], _mm256_loadu_pd(values + i + k * 4));
+    }
+    __m256d total = _mm256_add_pd(_mm256_add_pd(acc[0], acc[1]), _mm256_add_pd(acc[2], acc[3]));
+    return sumFrom(values, i, count, horizontalSum(total));
+}
+
+static AVX2 double minAvx2(const double *values, int count) {
+    if (count < 4) return minScalar(values, count);
+    __m256d acc = _mm256_loadu_pd(values);
+    int i = 4;
+    for (; i + 4 <= count; i += 4) acc = _mm256_min_pd(_mm256_loadu_pd(values + i), acc);
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    return minFrom(values, i, count, minScalar(lanes, 4));
+}
+
+static AVX2 double maxAvx2(const double *values, int count) {
+    if (count < 4) return maxScalar(values, count);
+    __m256d acc = _mm256_loadu_pd(values);
+    int i = 4;
+    for (; i + 4 <= count; i += 4) acc = _mm256_max_pd(_mm256_loadu_pd(values + i), acc);
+    double lanes[4];
+    _mm256_storeu_pd(lanes, acc);
+    return maxFrom(values, i, count, maxScalar(lanes, 4));
+}
+
+static AVX2 double dotAvx2(const double *a, const double *b, int count) {
+    __m256d acc[4] = {_mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd()};
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        for (int k = 0; k < 4; k++) {
+            __m256d product = _mm256_mul_pd(_mm256_loadu_pd(a + i + k * 4), _mm256_loadu_pd(b + i + k * 4));
+            acc[k] = _mm256_add_pd(acc[k], product);
+        }
+    }
+    __m256d total = _mm256_add_pd(_mm256_add_pd(acc[0], acc[1]), _mm256_add_pd(acc[2], acc[3]));
+    return dotFrom(a, b, i, count, horizontalSum(total));
+}
+
+static AVX2 void scaleAvx2(double *out, const double *values, double factor, int count) {
+    __m256d by = _mm256_set1_pd(factor);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(values + i), by));
+    scaleFrom(out, values, factor, i, count);
+}
+
+static AVX2 void addAvx2(double *out, const double *a, const double *b, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    }
+    addFrom(out, a, b, i, count);
+}
+
+static AVX2 void mulAvx2(double *out, const double *a, const double *b, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    }
+    mulFrom(out, a, b, i, count);
+}
+
+static const Kernels avx2Kernels = {
+        "avx2", sumAvx2, minAvx2, maxAvx2, dotAvx2, scaleAvx2, addAvx2, mulAvx2
+};
+
+#endif
+
+static const Kernels *kernels = &scalarKernels;
+static pthread_once_t kernelsChosen = PTHREAD_ONCE_INIT;
+
+static void chooseKernels() {
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels = &avx2Kernels;
+    } else if (__builtin_cpu_supports("sse2")) {
+        kernels = &sse2Kernels;
+    }
+#endif
+}
+
+static const Kernels *getKernels() {
+    pthread_once(&kernelsChosen, chooseKernels);
+    return kernels;
+}
+
+double sumFloat64(const double *values, int count) {
+    return getKernels()->sum(values, count);
+}
+
+double minFloat64(const double *values, int count) {
+    return getKernels()->min(values, count);
+}
+
+double maxFloat64(const double *values, int count) {
+    return getKernels()->max(values, count);
+}
+
+double dotFloat64(const double *a, const double *b, int count) {
+    return getKernels()->dot(a, b, count);
+}
+
+void scaleFloat64(double *out, const double *values, double factor, int count) {
+    getKernels()->scale(out, values, factor, count);
+}
+
+void addFloat64(double *out, const double *a, const double *b, int count) {
+    getKernels()->add(out, a, b, count);
+}
+
+void mulFloat64(double *out, const double *a, const double *b, int count) {
+    getKernels()->mul(out, a, b, count);
+}
+
+const char *kernelIsa() {
+    return getKernels()->isa;
+}
@@ -0,0 +1,36 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#ifndef CSCRIPTY_KERNELS_H
+#define CSCRIPTY_KERNELS_H
+
+#include "common.h"
+
+// Bulk operations over raw double arrays, used by the float64 array
+// methods. The widest instruction set the CPU supports (AVX2, then SSE2,
+// then plain C) is picked on first use. Vector kernels keep several
+// partial sums, so sum() and dot() may round differently from a
+// left-to-right loop.
+
+double sumFloat64(const double *values, int count);
+
+// `count` must be at least 1.
+double minFloat64(const double *values, int count);
+
+double maxFloat64(const double *values, int count);
+
+double dotFloat64(const double *a, const double *b, int count);
+
+// The element-wise kernels write `count` results to `out`, which must not
+// overlap the inputs.
+void scaleFloat64(double *out, const double *values, double factor, int count);
+
+void addFloat64(double *out, const double *a, const double *b, int count);
+
+void mulFloat64(double *out, const double *a, const double *b, int count);
+
+// "avx2", "sse2" or "scalar".
+const char *kernelIsa();
+
+#endif //CSCRIPTY_KERNELS_H
@@ -1,10 +1,31 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <signal.h>
+#include <unistd.h>
 #include "common.h"
 #include "vm.h"
+#include "batch.h"
+#include "intern.h"
+#include "compiler.h"
+#include "sampler.h"
+#include "memory.h"
 
-static void repl() {
+static VM *runningVM;
+
+static void onInterrupt(int signal) {
+    (void) signal;
+    interruptVM(runningVM);
+}
+
+// While a script runs, Ctrl-C stops it at its next loop iteration or call
+// instead of killing the process, so the REPL survives a runaway loop.
+// Elsewhere, such as at the prompt, Ctrl-C keeps its default and quits.
+static void catchInterrupts(bool catching) {
+    signal(SIGINT, catching ? onInterrupt : SIG_DFL);
+}
+
+static void repl(VM *vm) {
     char line[1024];
     for (;;) {
         printf(">> ");
@@ -14,7 +35,9 @@ static void repl() {
             break;
         }
 
-        interpret(line);
+        catchInterrupts(true);
+        interpret(vm, line);
+        catchInterrupts(false);
     }
 }
 
@@ -43,25 +66,195 @@ static char *readFile(const char *path) {
     return buffer;
 }
 
-static void runFile(const char *path) {
+static int runFile(VM *vm, const char *path) {
     char *source = readFile(path);
-    InterpretResult result = interpret(source);
+    catchInterrupts(true);
+    InterpretResult result = interpret(vm, source);
+    catchInterrupts(false);
     free(source);
 
-    if (result == COMPILE_ERROR) exit(65);
-    if (result == RUNTIME_ERROR) exit(70);
+    if (result == COMPILE_ERROR) return 65;
+    if (result != OK) return 70;
+    return 0;
+}
+
+// Runs a script from `path`, or from stdin without one, a top-level
+// declaration at a time as it is read.
+static int runStream(VM *vm, const char *path) {
+    FILE *file = stdin;
+    if (path != NULL) {
+        file = fopen(path, "rb");
+        if (file == NULL) {
+            fprintf(stderr, "Could not open file '%s'.\n", path);
+            exit(74);
+        }
+    }
+    catchInterrupts(true);
+    InterpretResult result = interpretStream(vm, file);
+    catchInterrupts(false);
+    bool failed = ferror(file);
+    if (path != NULL) fclose(file);
+
+    if (failed) {
+        fprintf(stderr, "Could not read '%s'.\n", path != NULL ? path : "stdin");
+        return 74;
+    }
+    if (result == COMPILE_ERROR) return 65;
+    if (result != OK) return 70;
+    return 0;
+}
+
+static int decodeTraceFile(VM *vm, const char *tracePath, const char *path) {
+    FILE *trace = fopen(tracePath, "rb");
+    if (trace == NULL) {
+        fprintf(stderr, "Could not open trace '%s'.\n", tracePath);
+        return 74;
+    }
+    char *source = readFile(path);
+    Chunk chunk;
+    initChunk(&chunk);
+    int status = 65;
+    if (compile(vm, source, &chunk)) {
+        status = decodeTrace(vm, &chunk, trace) ? 0 : 65;
+    }
+    freeChunk(vm, &chunk);
+    free(source);
+    fclose(trace);
+    return status;
+}
+
+static void usage() {
+    fprintf(stderr, "Usage: scripty [--profile[=folded-file]] [--sample[=hz]] [--trace[=trace-file]]\n"
+                    "              [--mem-stats] [--budget=back-edges] [--stream] [path]\n"
+                    "       scripty --decode-trace=trace-file path\n"
+                    "       scripty --batch [-j workers] [--slice=back-edges] path|@manifest...\n");
+    exit(64);
 }
 
 int main(int argc, const char *argv[]) {
-    initVM();
-    if (argc == 1) {
-        repl();
-    } else if (argc == 2) {
-        runFile(argv[1]);
-    } else {
-        fprintf(stderr, "Usage: scripty [path]\n");
+    if (argc >= 2 && strcmp(argv[1], "--batch") == 0) {
+        int workers = 0;
+        uint64_t slice = 0;
+        int first = 2;
+        for (;;) {
+            if (argc >= first + 2 && strcmp(argv[first], "-j") == 0) {
+                workers = atoi(argv[first + 1]);
+                first += 2;
+            } else if (argc > first && strncmp(argv[first], "--slice=", 8) == 0) {
+                slice = strtoull(argv[first] + 8, NULL, 10);
+                first++;
+            } else {
+                break;
+            }
+        }
+        int status = runBatch(argc - first, argv + first, workers, slice);
+        freeSharedStrings();
+        return status;
+    }
+
+    const char *profilePath = NULL;
+    const char *tracePath = NULL;
+    const char *decodePath = NULL;
+    int sampleHz = 0;
+    bool memStats = false;
+    bool stream = false;
+    uint64_t budget = 0;
+    int arg = 1;
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++) {
+        if (strcmp(argv[arg], "--profile") == 0) {
+            profilePath = "scripty.folded";
+        } else if (strncmp(argv[arg], "--profile=", 10) == 0) {
+            profilePath = argv[arg] + 10;
+        } else if (strcmp(argv[arg], "--sample") == 0) {
+            sampleHz = SAMPLE_DEFAULT_HZ;
+        } else if (strncmp(argv[arg], "--sample=", 9) == 0) {
+            sampleHz = atoi(argv[arg] + 9);
+        } else if (strcmp(argv[arg], "--trace") == 0) {
+            tracePath = "scripty.trace";
+        } else if (strncmp(argv[arg], "--trace=", 8) == 0) {
+            tracePath = argv[arg] + 8;
+        } else if (strncmp(argv[arg], "--budget=", 9) == 0) {
+            budget = strtoull(argv[arg] + 9, NULL, 10);
+        } else if (strcmp(argv[arg], "--mem-stats") == 0) {
+            memStats = true;
+        } else if (strcmp(argv[arg], "--stream") == 0) {
+            stream = true;
+        } else if (strncmp(argv[arg], "--decode-trace=", 15) == 0) {
+            decodePath = argv[arg] + 15;
+        } else {
+            usage();
+        }
+    }
+    if (argc - arg > 1) usage();
+    if (decodePath != NULL && argc - arg != 1) usage();
+    // Piped input is streamed rather than read line by line as in the REPL.
+    if (arg == argc && decodePath == NULL && tracePath == NULL && !isatty(fileno(stdin))) stream = true;
+    // Trace offsets are into one chunk, and a stream compiles many.
+    if (stream && (tracePath != NULL || decodePath != NULL)) usage();
+
+    VM vm;
+    initVM(&vm);
+    if (decodePath != NULL) {
+        int status = decodeTraceFile(&vm, decodePath, argv[arg]);
+        freeVM(&vm);
+        freeSharedStrings();
+        return status;
+    }
+
+    Tracer *tracer = NULL;
+    if (tracePath != NULL) {
+        tracer = malloc(sizeof(Tracer));
+        if (tracer == NULL) exit(1);
+        initTracer(tracer, tracePath);
+        vm.tracer = tracer;
+    }
+    const char *name = arg < argc ? argv[arg] : stream ? "stdin" : "repl";
+    Profiler profiler;
+    if (profilePath != NULL) {
+        initProfiler(&profiler, name);
+        vm.profiler = &profiler;
+    }
+
+    if (sampleHz != 0 && !startSampler(&vm, sampleHz)) {
+        fprintf(stderr, "Could not start the sampling profiler.\n");
         exit(64);
     }
-    freeVM();
-    return 0;
+
+    setBudget(&vm, budget, PREEMPT_ABORT);
+    runningVM = &vm;
+
+    int status = 0;
+    if (stream) {
+        status = runStream(&vm, arg < argc ? argv[arg] : NULL);
+    } else if (arg == argc) {
+        repl(&vm);
+    } else {
+        status = runFile(&vm, argv[arg]);
+    }
+
+    if (sampleHz != 0) {
+        stopSampler();
+        writeSampleReport(name, stderr);
+        if (!writeSampledStacks(name, "scripty.sampled")) {
+            fprintf(stderr, "Could not write profile 'scripty.sampled'.\n");
+        }
+        freeSampler();
+    }
+    if (profilePath != NULL) {
+        writeProfileReport(&profiler, stderr);
+        if (!writeFoldedStacks(&profiler, profilePath)) {
+            fprintf(stderr, "Could not write profile '%s'.\n", profilePath);
+        }
+        freeProfiler(&profiler);
+    }
+    if (tracer != NULL) {
+        if (status != 70 && !dumpTrace(tracer)) {
+            fprintf(stderr, "Could not write trace '%s'.\n", tracePath);
+        }
+        free(tracer);
+    }
+    if (memStats) writeMemoryReport(&vm, stderr);
+    freeVM(&vm);
+    freeSharedStrings();
+    return status;
 }
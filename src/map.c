@@ -0,0 +1,153 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#include <string.h>
+#include "map.h"
+#include "memory.h"
+
+#define MAP_MAX_LOAD 0.75
+
+// Empty slots and tombstones both have a null key; a tombstone's value is
+// true, the same convention Table uses.
+#define IS_FREE(entry) IS_NULL((entry)->key)
+
+static uint32_t hashBits(uint64_t bits) {
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdull;
+    bits ^= bits >> 33;
+    return (uint32_t) bits;
+}
+
+static uint32_t hashValue(Value key) {
+    switch (key.type) {
+        case V_BOOL:
+            return AS_BOOL(key) ? 1231 : 1237;
+        case V_INT:
+            return hashBits((uint64_t) AS_INT(key));
+        case V_NUM: {
+            // 0 and -0 are equal, so they must hash alike.
+            double number = AS_NUM(key) == 0 ? 0 : AS_NUM(key);
+            uint64_t bits;
+            memcpy(&bits, &number, sizeof(bits));
+            return hashBits(bits);
+        }
+        case V_OBJ:
+            if (IS_STRING(key)) return AS_STRING(key)->hash;
+            return hashBits((uint64_t) (uintptr_t) AS_OBJ(key));
+        default:
+            return 0;
+    }
+}
+
+static bool keysEqual(Value a, Value b) {
+    if (a.type != b.type) return false;
+    switch (a.type) {
+        case V_BOOL:
+            return AS_BOOL(a) == AS_BOOL(b);
+        case V_NUM:
+            return AS_NUM(a) == AS_NUM(b);
+        case V_INT:
+            return AS_INT(a) == AS_INT(b);
+        case V_OBJ:
+            if (IS_STRING(a) && IS_STRING(b)) return stringsEqual(AS_STRING(a), AS_STRING(b));
+            return AS_OBJ(a) == AS_OBJ(b);
+        default:
+            return false;
+    }
+}
+
+static MapEntry *findEntry(MapEntry *entries, int capacity, Value key, uint32_t hash) {
+    uint32_t index = hash % capacity;
+    MapEntry *tombstone = NULL;
+    for (;;) {
+        MapEntry *entry = &entries[index];
+        if (IS_FREE(entry)) {
+            if (IS_NULL(entry->value)) {
+                return tombstone != NULL ? tombstone : entry;
+            } else {
+                if (tombstone == NULL) tombstone = entry;
+            }
+        } else if (entry->hash == hash && keysEqual(entry->key, key)) {
+            return entry;
+        }
+        index = (index + 1) % capacity;
+    }
+}
+
+// Entries keep their hash, so growing never rehashes a key.
+static void adjustCapacity(VM *vm, ObjMap *map, int capacity) {
+    MapEntry *entries = ALLOCATE(vm, MEM_MAP, MapEntry, capacity);
+    for (int i = 0; i < capacity; i++) {
+        entries[i].key = NULL_VAL;
+        entries[i].value = NULL_VAL;
+    }
+    map->count = 0;
+    for (int i = 0; i < map->capacity; i++) {
+        MapEntry *entry = &map->entries[i];
+        if (IS_FREE(entry)) continue;
+        MapEntry *dest = findEntry(entries, capacity, entry->key, entry->hash);
+        *dest = *entry;
+        map->count++;
+    }
+    FREE_ARRAY(vm, MEM_MAP, MapEntry, map->entries, map->capacity);
+    map->entries = entries;
+    map->capacity = capacity;
+}
+
+// Equal keys must end up with one representation: ropes become strings and
+// doubles holding a whole number become integers, so 2.0 finds 2.
+static Value normalizeKey(VM *vm, Value key) {
+    if (IS_ROPE(key)) return OBJ_VAL(flattenRope(vm, AS_ROPE(key)));
+    if (IS_NUM(key) && AS_NUM(key) >= -9223372036854775808.0 && AS_NUM(key) < 9223372036854775808.0 &&
+        AS_NUM(key) == (double) (int64_t) AS_NUM(key)) {
+        return INT_VAL((int64_t) AS_NUM(key));
+    }
+    return key;
+}
+
+bool mapGet(VM *vm, ObjMap *map, Value key, Value *value) {
+    if (map->live == 0) return false;
+    key = normalizeKey(vm, key);
+    MapEntry *entry = findEntry(map->entries, map->capacity, key, hashValue(key));
+    if (IS_FREE(entry)) return false;
+    *value = entry->value;
+    return true;
+}
+
+bool mapSet(VM *vm, ObjMap *map, Value key, Value value) {
+    if (map->count + 1 > map->capacity * MAP_MAX_LOAD) {
+        adjustCapacity(vm, map, GROW_CAPACITY(map->capacity));
+    }
+    key = normalizeKey(vm, key);
+    uint32_t hash = hashValue(key);
+    MapEntry *entry = findEntry(map->entries, map->capacity, key, hash);
+    bool isNewKey = IS_FREE(entry);
+    if (isNewKey) {
+        if (IS_NULL(entry->value)) map->count++;
+        map->live++;
+        entry->key = key;
+        entry->hash = hash;
+    }
+    entry->value = value;
+    return isNewKey;
+}
+
+bool mapDelete(VM *vm, ObjMap *map, Value key) {
+    if (map->live == 0) return false;
+    key = normalizeKey(vm, key);
+    MapEntry *entry = findEntry(map->entries, map->capacity, key, hashValue(key));
+    if (IS_FREE(entry)) return false;
+    entry->key = NULL_VAL;
+    entry->value = BOOL_VAL(true);
+    map->live--;
+    return true;
+}
+
+void freeMap(VM *vm, ObjMap *map) {
+    FREE_ARRAY(vm, MEM_MAP, MapEntry, map->entries, map->capacity);
+    map->entries = NULL;
+    map->capacity = 0;
+    map->count = 0;
+    map->live = 0;
+}
@@ -0,0 +1,23 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#ifndef CSCRIPTY_MAP_H
+#define CSCRIPTY_MAP_H
+
+#include "common.h"
+#include "object.h"
+
+// Keys may be any value except null; callers check that before calling in.
+// String keys compare by contents and ropes are flattened first, other
+// objects compare by identity.
+bool mapGet(VM *vm, ObjMap *map, Value key, Value *value);
+
+// Returns true if `key` was not in the map before.
+bool mapSet(VM *vm, ObjMap *map, Value key, Value value);
+
+bool mapDelete(VM *vm, ObjMap *map, Value key);
+
+void freeMap(VM *vm, ObjMap *map);
+
+#endif //CSCRIPTY_MAP_H
@@ -3,10 +3,21 @@
 //
 
 #include "stdlib.h"
+#include "string.h"
 #include "memory.h"
 #include "vm.h"
+#include "map.h"
+#include "intern.h"
 
-void *reallocate(void *ptr, size_t oldSize, size_t newSize) {
+static void account(MemCounter *counter, size_t oldSize, size_t newSize) {
+    counter->live = counter->live - oldSize + newSize;
+    if (counter->live > counter->peak) counter->peak = counter->live;
+    if (newSize > 0) counter->allocations++;
+}
+
+void *reallocate(VM *vm, void *ptr, size_t oldSize, size_t newSize, MemCategory category) {
+    account(&vm->memory.categories[category], oldSize, newSize);
+    account(&vm->memory.total, oldSize, newSize);
     if (newSize == 0) {
         free(ptr);
         return NULL;
@@ -17,22 +28,186 @@ void *reallocate(void *ptr, size_t oldSize, size_t newSize) {
     return result;
 }
 
-static void freeObject(Obj *object) {
+static void freeObject(VM *vm, Obj *object) {
     switch (object->type) {
         case O_STRING: {
             ObjString *string = (ObjString *) object;
-            FREE_ARRAY(char, string->chars, string->length + 1);
-            FREE(ObjString, object);
+            FREE_ARRAY(vm, MEM_STRING, char, string->chars, string->length + 1);
+            FREE(vm, MEM_STRING, ObjString, object);
             break;
         }
+        case O_ROPE:
+            FREE(vm, MEM_STRING, ObjRope, object);
+            break;
+        case O_LIST:
+            freeValueArray(vm, &((ObjList *) object)->items);
+            FREE(vm, MEM_LIST, ObjList, object);
+            break;
+        case O_MAP:
+            freeMap(vm, (ObjMap *) object);
+            FREE(vm, MEM_MAP, ObjMap, object);
+            break;
+        case O_ARRAY: {
+            ObjArray *array = (ObjArray *) object;
+            FREE_ARRAY(vm, MEM_ARRAY, double, array->values, array->count);
+            FREE(vm, MEM_ARRAY, ObjArray, object);
+            break;
+        }
+        case O_FUNCTION:
+            freeChunk(vm, &((ObjFunction *) object)->chunk);
+            FREE(vm, MEM_CODE, ObjFunction, object);
+            break;
+        case O_NATIVE:
+            FREE(vm, MEM_CODE, ObjNative, object);
+            break;
     }
 }
 
-void freeObjects() {
-    Obj *object = vm.objects;
+static size_t objectSize(Obj *object) {
+    if (object->type == O_STRING) {
+        return sizeof(ObjString) + ((ObjString *) object)->length + 1;
+    }
+    if (object->type == O_LIST) {
+        return sizeof(ObjList) + sizeof(Value) * ((ObjList *) object)->items.capacity;
+    }
+    if (object->type == O_MAP) {
+        return sizeof(ObjMap) + sizeof(MapEntry) * ((ObjMap *) object)->capacity;
+    }
+    if (object->type == O_ARRAY) {
+        return sizeof(ObjArray) + sizeof(double) * ((ObjArray *) object)->count;
+    }
+    if (object->type == O_FUNCTION) {
+        Chunk *chunk = &((ObjFunction *) object)->chunk;
+        return sizeof(ObjFunction) + (sizeof(uint8_t) + sizeof(int)) * chunk->capacity +
+               sizeof(Value) * chunk->constants.capacity;
+    }
+    if (object->type == O_NATIVE) {
+        return sizeof(ObjNative);
+    }
+    return sizeof(ObjRope);
+}
+
+static const char *objTypeName(ObjType type) {
+    switch (type) {
+        case O_STRING:
+            return "string";
+        case O_ROPE:
+            return "rope";
+        case O_LIST:
+            return "list";
+        case O_MAP:
+            return "map";
+        case O_ARRAY:
+            return "array";
+        case O_FUNCTION:
+            return "function";
+        case O_NATIVE:
+            return "native";
+    }
+    return "?";
+}
+
+static const char *categoryName(MemCategory category) {
+    switch (category) {
+        case MEM_STRING:
+            return "strings";
+        case MEM_CODE:
+            return "code";
+        case MEM_LINES:
+            return "lines";
+        case MEM_CONSTANTS:
+            return "constants";
+        case MEM_TABLE:
+            return "tables";
+        case MEM_STACK:
+            return "stack";
+        case MEM_LIST:
+            return "lists";
+        case MEM_MAP:
+            return "maps";
+        case MEM_ARRAY:
+            return "arrays";
+        default:
+            return "?";
+    }
+}
+
+static int textLength(Obj *object) {
+    return object->type == O_ROPE ? ((ObjRope *) object)->length : ((ObjString *) object)->length;
+}
+
+// The first characters of a string or rope, without flattening it: a rope
+// shows its leftmost piece.
+static ObjString *leadingPiece(Obj *object) {
+    while (object->type == O_ROPE) {
+        ObjRope *rope = (ObjRope *) object;
+        if (rope->flat != NULL) return rope->flat;
+        object = rope->left;
+    }
+    return (ObjString *) object;
+}
+
+void takeHeapSnapshot(VM *vm, HeapSnapshot *snapshot) {
+    memset(snapshot, 0, sizeof(HeapSnapshot));
+    for (Obj *object = vm->objects; object != NULL; object = object->next) {
+        HeapTypeStats *stats = &snapshot->types[object->type];
+        stats->count++;
+        stats->bytes += objectSize(object);
+        if (object->type != O_STRING && object->type != O_ROPE) continue;
+
+        // Insertion into the short list of largest strings, biggest first.
+        int length = textLength(object);
+        int i = snapshot->largestCount;
+        if (i == HEAP_TOP_STRINGS) {
+            if (textLength(snapshot->largest[i - 1]) >= length) continue;
+            i--;
+        } else {
+            snapshot->largestCount++;
+        }
+        for (; i > 0 && textLength(snapshot->largest[i - 1]) < length; i--) {
+            snapshot->largest[i] = snapshot->largest[i - 1];
+        }
+        snapshot->largest[i] = object;
+    }
+}
+
+void writeMemoryReport(VM *vm, FILE *out) {
+    fprintf(out, "== memory ==\n");
+    fprintf(out, "%-10s %14s %14s %12s\n", "category", "live", "peak", "allocations");
+    for (int i = 0; i < MEM_CATEGORY_COUNT; i++) {
+        MemCounter *counter = &vm->memory.categories[i];
+        fprintf(out, "%-10s %14zu %14zu %12zu\n", categoryName((MemCategory) i),
+                counter->live, counter->peak, counter->allocations);
+    }
+    fprintf(out, "%-10s %14zu %14zu %12zu\n", "total",
+            vm->memory.total.live, vm->memory.total.peak, vm->memory.total.allocations);
+
+    HeapSnapshot snapshot;
+    takeHeapSnapshot(vm, &snapshot);
+    fprintf(out, "%-10s %14s %14s\n", "object", "count", "bytes");
+    for (int i = 0; i < OBJ_TYPE_COUNT; i++) {
+        fprintf(out, "%-10s %14d %14zu\n", objTypeName((ObjType) i),
+                snapshot.types[i].count, snapshot.types[i].bytes);
+    }
+    for (int i = 0; i < snapshot.largestCount; i++) {
+        Obj *object = snapshot.largest[i];
+        ObjString *piece = leadingPiece(object);
+        int shown = piece->length < 40 ? piece->length : 40;
+        fprintf(out, "%10d bytes %s\"%.*s%s\"\n", textLength(object), object->type == O_ROPE ? "rope " : "",
+                shown, piece->chars, textLength(object) > shown ? "..." : "");
+    }
+
+    SharedStringStats shared;
+    sharedStringStats(&shared);
+    fprintf(out, "shared strings (every VM): %u interned, %zu bytes, table %zu bytes in %u slots, fullest shard %u\n",
+            shared.strings, shared.stringBytes, shared.tableBytes, shared.slots, shared.fullestShard);
+}
+
+void freeObjects(VM *vm) {
+    Obj *object = vm->objects;
     while (object != NULL) {
         Obj *next = object->next;
-        freeObject(object);
+        freeObject(vm, object);
         object = next;
     }
 }
@@ -8,16 +8,48 @@
 #include "common.h"
 #include "object.h"
 
-#define FREE(t, ptr) reallocate(ptr, sizeof(t), 0)
+#include <stdio.h>
+
+#define FREE(vm, cat, t, ptr) reallocate(vm, ptr, sizeof(t), 0, cat)
 #define GROW_CAPACITY(cap) ((cap) < 8 ? 8 : (cap) * 8)
-#define GROW_ARRAY(t, ptr, oldCount, newCount) \
-(t*)reallocate(ptr, sizeof(t) * (oldCount), sizeof(t) * (newCount))
-#define FREE_ARRAY(t, ptr, oldCount) \
-reallocate(ptr, sizeof(t) * (oldCount), 0)
-#define ALLOCATE(t, count) (t*)reallocate(NULL, 0, sizeof(t) * (count))
+#define GROW_ARRAY(vm, cat, t, ptr, oldCount, newCount) \
+(t*)reallocate(vm, ptr, sizeof(t) * (oldCount), sizeof(t) * (newCount), cat)
+#define FREE_ARRAY(vm, cat, t, ptr, oldCount) \
+reallocate(vm, ptr, sizeof(t) * (oldCount), 0, cat)
+#define ALLOCATE(vm, cat, t, count) (t*)reallocate(vm, NULL, 0, sizeof(t) * (count), cat)
+
+#define HEAP_TOP_STRINGS 10
+
+typedef struct {
+    size_t live;
+    size_t peak;
+    size_t allocations;
+} MemCounter;
+
+typedef struct {
+    MemCounter categories[MEM_CATEGORY_COUNT];
+    MemCounter total;
+} MemStats;
+
+typedef struct {
+    int count;
+    size_t bytes;
+} HeapTypeStats;
+
+// Per-type census of the objects a VM owns, plus its largest strings and
+// ropes.
+typedef struct {
+    HeapTypeStats types[OBJ_TYPE_COUNT];
+    Obj *largest[HEAP_TOP_STRINGS];
+    int largestCount;
+} HeapSnapshot;
+
+void *reallocate(VM *vm, void *ptr, size_t oldSize, size_t newSize, MemCategory category);
+
+void freeObjects(VM *vm);
 
-void *reallocate(void *ptr, size_t oldSize, size_t newSize);
+void takeHeapSnapshot(VM *vm, HeapSnapshot *snapshot);
 
-void freeObjects();
+void writeMemoryReport(VM *vm, FILE *out);
 
 #endif //CSCRIPTY_MEMORY_H
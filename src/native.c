@@ -0,0 +1,58 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include "native.h"
+#include "table.h"
+#include "vm.h"
+
+static ObjNative *bindNative(VM *vm, const char *name, int arity) {
+    ObjString *key = copyString(vm, name, (int) strlen(name));
+    ObjNative *native = newNative(vm, key, arity);
+    tableSet(vm, &vm->globals, key, OBJ_VAL(native));
+    return native;
+}
+
+void defineNative(VM *vm, const char *name, int arity, NativeFn function) {
+    bindNative(vm, name, arity)->generic = function;
+}
+
+void defineFastNative1(VM *vm, const char *name, FastFn1 function) {
+    bindNative(vm, name, 1)->fast.one = function;
+}
+
+void defineFastNative2(VM *vm, const char *name, FastFn2 function) {
+    bindNative(vm, name, 2)->fast.two = function;
+}
+
+void defineFastNative3(VM *vm, const char *name, FastFn3 function) {
+    bindNative(vm, name, 3)->fast.three = function;
+}
+
+static bool clockNative(VM *vm, int argCount, Value *args, Value *result) {
+    (void) vm;
+    (void) argCount;
+    (void) args;
+    *result = NUM_VAL((double) clock() / CLOCKS_PER_SEC);
+    return true;
+}
+
+static double clampNative(double x, double low, double high) {
+    return x < low ? low : x > high ? high : x;
+}
+
+void defineStandardNatives(VM *vm) {
+    defineNative(vm, "clock", 0, clockNative);
+    defineFastNative1(vm, "sqrt", sqrt);
+    defineFastNative1(vm, "exp", exp);
+    defineFastNative1(vm, "log", log);
+    defineFastNative1(vm, "floor", floor);
+    defineFastNative1(vm, "abs", fabs);
+    defineFastNative2(vm, "pow", pow);
+    defineFastNative2(vm, "min", fmin);
+    defineFastNative2(vm, "max", fmax);
+    defineFastNative3(vm, "clamp", clampNative);
+}
@@ -0,0 +1,29 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#ifndef CSCRIPTY_NATIVE_H
+#define CSCRIPTY_NATIVE_H
+
+#include "common.h"
+#include "object.h"
+
+// Binds `name` in the VM's globals to a host function. A script can
+// redefine or shadow it like any other global.
+void defineNative(VM *vm, const char *name, int arity, NativeFn function);
+
+// Fast-call natives receive their arguments as raw doubles and push no call
+// frame. Where the compiler proves every argument numeric it emits
+// OP_CALL_NN, which reads them off the stack without type checks; other
+// call sites check each argument, and a non-number is a runtime error.
+void defineFastNative1(VM *vm, const char *name, FastFn1 function);
+
+void defineFastNative2(VM *vm, const char *name, FastFn2 function);
+
+void defineFastNative3(VM *vm, const char *name, FastFn3 function);
+
+// clock(), and the math helpers sqrt, exp, log, floor, abs, pow, min, max
+// and clamp. initVM() defines these in every VM.
+void defineStandardNatives(VM *vm);
+
+#endif //CSCRIPTY_NATIVE_H
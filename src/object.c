@@ -10,23 +10,40 @@
 #include "value.h"
 #include "vm.h"
 #include "table.h"
+#include "intern.h"
 
-#define ALLOCATE_OBJ(t, ot) (t*)allocateObject(sizeof(t), ot)
+#define ALLOCATE_OBJ(vm, t, ot) (t*)allocateObject(vm, sizeof(t), ot)
 
-static Obj *allocateObject(size_t size, ObjType type) {
-    Obj *object = (Obj *) reallocate(NULL, 0, size);
+static MemCategory objectCategory(ObjType type) {
+    switch (type) {
+        case O_LIST:
+            return MEM_LIST;
+        case O_MAP:
+            return MEM_MAP;
+        case O_ARRAY:
+            return MEM_ARRAY;
+        case O_FUNCTION:
+        case O_NATIVE:
+            return MEM_CODE;
+        default:
+            return MEM_STRING;
+    }
+}
+
+static Obj *allocateObject(VM *vm, size_t size, ObjType type) {
+    Obj *object = (Obj *) reallocate(vm, NULL, 0, size, objectCategory(type));
     object->type = type;
-    object->next = vm.objects;
-    vm.objects = object;
+    object->next = vm->objects;
+    vm->objects = object;
     return object;
 }
 
-static ObjString *allocateString(char *chars, int length, uint32_t hash) {
-    ObjString *string = ALLOCATE_OBJ(ObjString, O_STRING);
+static ObjString *allocateString(VM *vm, char *chars, int length, uint32_t hash) {
+    ObjString *string = ALLOCATE_OBJ(vm, ObjString, O_STRING);
     string->length = length;
     string->chars = chars;
     string->hash = hash;
-    tableSet(&vm.strings, string, NULL_VAL);
+    string->interned = false;
     return string;
 }
 
@@ -39,31 +56,202 @@ static uint32_t hashString(const char *key, int length) {
     return hash;
 }
 
-ObjString *copyString(const char *chars, int length) {
-    uint32_t hash = hashString(chars, length);
-    ObjString *interned = tableFindString(&vm.strings, chars, length, hash);
-    if (interned != NULL) return interned;
-    char *heapChars = ALLOCATE(char, length + 1);
-    memcpy(heapChars, chars, length);
-    heapChars[length] = '\0';
+ObjString *copyString(VM *vm, const char *chars, int length) {
+    (void) vm;
+    return internSharedString(chars, length, hashString(chars, length));
+}
+
+bool stringsEqual(ObjString *a, ObjString *b) {
+    if (a == b) return true;
+    if (a->interned && b->interned) return false;
+    return a->length == b->length &&
+           a->hash == b->hash &&
+           memcmp(a->chars, b->chars, a->length) == 0;
+}
+
+static int objLength(Obj *object) {
+    return object->type == O_ROPE ? ((ObjRope *) object)->length : ((ObjString *) object)->length;
+}
+
+Obj *concatStrings(VM *vm, Obj *a, Obj *b) {
+    int length = objLength(a) + objLength(b);
+    if (objLength(a) == 0) return b;
+    if (objLength(b) == 0) return a;
+
+    if (length < ROPE_MIN_LENGTH) {
+        // Ropes are never shorter than ROPE_MIN_LENGTH, so both sides are flat here.
+        ObjString *left = (ObjString *) a;
+        ObjString *right = (ObjString *) b;
+        char *chars = ALLOCATE(vm, MEM_STRING, char, length + 1);
+        memcpy(chars, left->chars, left->length);
+        memcpy(chars + left->length, right->chars, right->length);
+        chars[length] = '\0';
+        return (Obj *) takeString(vm, chars, length);
+    }
+
+    ObjRope *rope = ALLOCATE_OBJ(vm, ObjRope, O_ROPE);
+    rope->length = length;
+    rope->left = a;
+    rope->right = b;
+    rope->flat = NULL;
+    return (Obj *) rope;
+}
+
+ObjString *flattenRope(VM *vm, ObjRope *rope) {
+    if (rope->flat != NULL) return rope->flat;
+
+    int length = rope->length;
+    char *chars = ALLOCATE(vm, MEM_STRING, char, length + 1);
+    chars[length] = '\0';
+
+    // Walk the tree with an explicit stack and fill the buffer back to front.
+    // Ropes built by `s = s + x` lean left, so at most two nodes are pending.
+    int capacity = 8;
+    int count = 0;
+    Obj **pending = ALLOCATE(vm, MEM_STRING, Obj *, capacity);
+    pending[count++] = (Obj *) rope;
+    int end = length;
+    while (count > 0) {
+        Obj *node = pending[--count];
+        if (node->type == O_ROPE && ((ObjRope *) node)->flat == NULL) {
+            if (capacity < count + 2) {
+                int oldCap = capacity;
+                capacity = GROW_CAPACITY(oldCap);
+                pending = GROW_ARRAY(vm, MEM_STRING, Obj *, pending, oldCap, capacity);
+            }
+            pending[count++] = ((ObjRope *) node)->left;
+            pending[count++] = ((ObjRope *) node)->right;
+            continue;
+        }
+        ObjString *piece = node->type == O_ROPE ? ((ObjRope *) node)->flat : (ObjString *) node;
+        end -= piece->length;
+        memcpy(chars + end, piece->chars, piece->length);
+    }
+    FREE_ARRAY(vm, MEM_STRING, Obj *, pending, capacity);
+
+    rope->flat = takeString(vm, chars, length);
+    rope->left = NULL;
+    rope->right = NULL;
+    return rope->flat;
+}
+
+ObjList *newList(VM *vm) {
+    ObjList *list = ALLOCATE_OBJ(vm, ObjList, O_LIST);
+    initValueArray(&list->items, MEM_LIST);
+    return list;
+}
+
+ObjMap *newMap(VM *vm) {
+    ObjMap *map = ALLOCATE_OBJ(vm, ObjMap, O_MAP);
+    map->count = 0;
+    map->live = 0;
+    map->capacity = 0;
+    map->entries = NULL;
+    return map;
+}
 
-    return allocateString(heapChars, length, hash);
+ObjArray *newFloat64Array(VM *vm, int count) {
+    ObjArray *array = ALLOCATE_OBJ(vm, ObjArray, O_ARRAY);
+    array->count = count;
+    array->values = ALLOCATE(vm, MEM_ARRAY, double, count);
+    return array;
 }
 
-void printObject(Value value) {
+// Lists and maps can contain themselves, so nesting is cut off past a
+// fixed depth.
+#define PRINT_MAX_DEPTH 16
+
+static void printNested(VM *vm, Value value, int depth);
+
+static void printList(VM *vm, ObjList *list, int depth) {
+    fputc('[', vm->out);
+    for (int i = 0; i < list->items.count; i++) {
+        if (i > 0) fputs(", ", vm->out);
+        printNested(vm, list->items.values[i], depth + 1);
+    }
+    fputc(']', vm->out);
+}
+
+static void printMap(VM *vm, ObjMap *map, int depth) {
+    fputc('{', vm->out);
+    bool first = true;
+    for (int i = 0; i < map->capacity; i++) {
+        MapEntry *entry = &map->entries[i];
+        if (IS_NULL(entry->key)) continue;
+        if (!first) fputs(", ", vm->out);
+        first = false;
+        printNested(vm, entry->key, depth + 1);
+        fputs(": ", vm->out);
+        printNested(vm, entry->value, depth + 1);
+    }
+    fputc('}', vm->out);
+}
+
+static void printNested(VM *vm, Value value, int depth) {
+    if (IS_LIST(value) || IS_MAP(value)) {
+        if (depth == PRINT_MAX_DEPTH) {
+            fputs(IS_LIST(value) ? "[...]" : "{...}", vm->out);
+        } else if (IS_LIST(value)) {
+            printList(vm, AS_LIST(value), depth);
+        } else {
+            printMap(vm, AS_MAP(value), depth);
+        }
+        return;
+    }
+    printValue(vm, value);
+}
+
+static void printArray(VM *vm, ObjArray *array) {
+    fputs("float64[", vm->out);
+    for (int i = 0; i < array->count; i++) {
+        if (i > 0) fputs(", ", vm->out);
+        printValue(vm, NUM_VAL(array->values[i]));
+    }
+    fputc(']', vm->out);
+}
+
+ObjFunction *newFunction(VM *vm, ObjString *name) {
+    ObjFunction *function = ALLOCATE_OBJ(vm, ObjFunction, O_FUNCTION);
+    function->arity = 0;
+    function->id = 0;
+    function->name = name;
+    initChunk(&function->chunk);
+    return function;
+}
+
+ObjNative *newNative(VM *vm, ObjString *name, int arity) {
+    ObjNative *native = ALLOCATE_OBJ(vm, ObjNative, O_NATIVE);
+    native->name = name;
+    native->arity = arity;
+    native->generic = NULL;
+    native->fast.one = NULL;
+    return native;
+}
+
+void printObject(VM *vm, Value value) {
     switch (OBJ_TYPE(value)) {
         case O_STRING:
-            printf("%s", AS_CSTRING(value));
+            fputs(AS_CSTRING(value), vm->out);
+            break;
+        case O_ROPE:
+            fputs(flattenRope(vm, AS_ROPE(value))->chars, vm->out);
+            break;
+        case O_LIST:
+        case O_MAP:
+            printNested(vm, value, 0);
+            break;
+        case O_ARRAY:
+            printArray(vm, AS_ARRAY(value));
+            break;
+        case O_FUNCTION:
+            fprintf(vm->out, "<fun %s>", AS_FUNCTION(value)->name->chars);
+            break;
+        case O_NATIVE:
+            fprintf(vm->out, "<native %s>", AS_NATIVE(value)->name->chars);
             break;
     }
 }
 
-ObjString *takeString(char *chars, int length) {
-    uint32_t hash = hashString(chars, length);
-    ObjString *interned = tableFindString(&vm.strings, chars, length, hash);
-    if (interned != NULL) {
-        FREE_ARRAY(char, chars, length + 1);
-        return interned;
-    }
-    return allocateString(chars, length, hash);
+ObjString *takeString(VM *vm, char *chars, int length) {
+    return allocateString(vm, chars, length, hashString(chars, length));
 }
@@ -4,6 +4,7 @@
 
 #include "common.h"
 #include "value.h"
+#include "chunk.h"
 
 #ifndef CSCRIPTY_OBJECT_H
 #define CSCRIPTY_OBJECT_H
@@ -11,14 +12,38 @@
 #define OBJ_TYPE(value)   (AS_OBJ(value)->type)
 
 #define IS_STRING(value)  isObjType(value, O_STRING)
+#define IS_ROPE(value)    isObjType(value, O_ROPE)
+#define IS_LIST(value)    isObjType(value, O_LIST)
+#define IS_MAP(value)     isObjType(value, O_MAP)
+#define IS_ARRAY(value)   isObjType(value, O_ARRAY)
+#define IS_FUNCTION(value) isObjType(value, O_FUNCTION)
+#define IS_NATIVE(value)  isObjType(value, O_NATIVE)
 
 #define AS_STRING(value)  ((ObjString*)AS_OBJ(value))
 #define AS_CSTRING(value) (((ObjString*)AS_OBJ(value))->chars)
+#define AS_ROPE(value)    ((ObjRope*)AS_OBJ(value))
+#define AS_LIST(value)    ((ObjList*)AS_OBJ(value))
+#define AS_MAP(value)     ((ObjMap*)AS_OBJ(value))
+#define AS_ARRAY(value)   ((ObjArray*)AS_OBJ(value))
+#define AS_FUNCTION(value) ((ObjFunction*)AS_OBJ(value))
+#define AS_NATIVE(value)  ((ObjNative*)AS_OBJ(value))
+
+// Concatenations shorter than this are copied eagerly; a rope node costs
+// more than copying a handful of bytes.
+#define ROPE_MIN_LENGTH 64
 
 typedef enum {
     O_STRING,
+    O_ROPE,
+    O_LIST,
+    O_MAP,
+    O_ARRAY,
+    O_FUNCTION,
+    O_NATIVE,
 } ObjType;
 
+#define OBJ_TYPE_COUNT (O_NATIVE + 1)
+
 struct Obj {
     ObjType type;
     struct Obj *next;
@@ -29,16 +54,125 @@ struct ObjString {
     int length;
     char *chars;
     uint32_t hash;
+    bool interned;
 };
 
-ObjString *takeString(char *chars, int length);
+// Deferred concatenation of two strings or ropes. The pieces are only
+// copied into a flat string once the contents are needed.
+typedef struct {
+    Obj obj;
+    int length;
+    Obj *left;
+    Obj *right;
+    ObjString *flat;
+} ObjRope;
 
-ObjString *copyString(const char *chars, int length);
+typedef struct {
+    Obj obj;
+    ValueArray items;
+} ObjList;
 
-void printObject(Value value);
+typedef struct {
+    Value key;
+    Value value;
+    uint32_t hash;
+} MapEntry;
+
+// Open-addressed like Table, but keyed by any value. `count` includes
+// tombstones for the load factor; `live` is what scripts see as the length.
+typedef struct {
+    Obj obj;
+    int count;
+    int live;
+    int capacity;
+    MapEntry *entries;
+} ObjMap;
+
+// A fixed-length float64 array. Elements are stored unboxed so the bulk
+// methods can hand `values` straight to the kernels in kernels.h.
+typedef struct {
+    Obj obj;
+    int count;
+    double *values;
+} ObjArray;
+
+// A compiled `fun` declaration. Functions are constants of the chunk that
+// declares them and, like every object, live until the VM is freed. `id`
+// numbers the functions of a script from 1 in the order they are parsed, so
+// a recompiled script numbers them the same way; the script itself is 0.
+typedef struct {
+    Obj obj;
+    int arity;
+    uint16_t id;
+    Chunk chunk;
+    ObjString *name;
+} ObjFunction;
+
+// The generic native signature. `args` points at the arguments on the VM
+// stack. A native that fails reports it with runtimeError() and returns
+// false.
+typedef bool (*NativeFn)(VM *vm, int argCount, Value *args, Value *result);
+
+// Fast-call signatures, for natives that take and return plain numbers.
+typedef double (*FastFn1)(double a);
+
+typedef double (*FastFn2)(double a, double b);
+
+typedef double (*FastFn3)(double a, double b, double c);
+
+// A host C function bound to a global. Exactly one of `generic` and the
+// `fast` member matching `arity` is set.
+typedef struct {
+    Obj obj;
+    ObjString *name;
+    // -1 accepts any number of arguments; fast natives have 1 to 3.
+    int arity;
+    NativeFn generic;
+    union {
+        FastFn1 one;
+        FastFn2 two;
+        FastFn3 three;
+    } fast;
+} ObjNative;
+
+// Strings built at runtime are not interned. copyString (literals and
+// identifiers) returns the canonical instance from the process-wide table
+// shared by every VM. stringsEqual compares by pointer only when both sides
+// are interned and by contents otherwise.
+ObjString *takeString(VM *vm, char *chars, int length);
+
+ObjString *copyString(VM *vm, const char *chars, int length);
+
+bool stringsEqual(ObjString *a, ObjString *b);
+
+Obj *concatStrings(VM *vm, Obj *a, Obj *b);
+
+ObjString *flattenRope(VM *vm, ObjRope *rope);
+
+ObjList *newList(VM *vm);
+
+ObjMap *newMap(VM *vm);
+
+// The elements are left uninitialised.
+ObjArray *newFloat64Array(VM *vm, int count);
+
+ObjFunction *newFunction(VM *vm, ObjString *name);
+
+// Leaves both calling conventions unset.
+ObjNative *newNative(VM *vm, ObjString *name, int arity);
+
+void printObject(VM *vm, Value value);
 
 static inline bool isObjType(Value value, ObjType type) {
     return IS_OBJ(value) && AS_OBJ(value)->type == type;
 }
 
+static inline bool isStringLike(Value value) {
+    return IS_STRING(value) || IS_ROPE(value);
+}
+
+static inline ObjString *asFlatString(VM *vm, Value value) {
+    return IS_ROPE(value) ? flattenRope(vm, AS_ROPE(value)) : AS_STRING(value);
+}
+
 #endif //CSCRIPTY_OBJECT_H
@@ -0,0 +1,678 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include "optimizer.h"
+#include "scanner.h"
+#include "table.h"
+#include "vm.h"
+
+// Passes over the whole tree are repeated until nothing changes, but no
+// more often than this.
+#define SIMPLIFY_ROUNDS 8
+
+typedef struct {
+    VM *vm;
+    Ir *ir;
+    Table *defined;
+    // How often each local is read and assigned, counted at the start of a
+    // round. Rewrites during the round only ever leave these too high.
+    int *reads;
+    int *writes;
+    bool changed;
+} Optimizer;
+
+static bool isFalsey(Value value) {
+    return IS_NULL(value) || (IS_BOOL(value) && !AS_BOOL(value));
+}
+
+static bool isConstant(Node *node) {
+    return node->kind == N_CONSTANT;
+}
+
+// True if evaluating the expression has no effect and cannot fail, so it
+// may be dropped, moved earlier or evaluated once for several uses. Relies
+// on the types of the last inferTypes(); nodes made since then are
+// TYPE_ANY, which only makes this answer false more often.
+static bool isPure(Node *node) {
+    switch (node->kind) {
+        case N_CONSTANT:
+        case N_GET_LOCAL:
+            return true;
+        case N_BINARY:
+            if (!isPure(node->a) || !isPure(node->b)) return false;
+            // Equality compares values of any type.
+            if (node->op == T_EQ || node->op == T_NE) return true;
+            return node->a->type == TYPE_NUMBER && node->b->type == TYPE_NUMBER;
+        case N_UNARY:
+            if (!isPure(node->a)) return false;
+            return node->op == T_BANG || node->a->type == TYPE_NUMBER;
+        case N_AND:
+        case N_OR:
+            return isPure(node->a) && isPure(node->b);
+        default:
+            return false;
+    }
+}
+
+// A pure expression worth keeping in a local rather than computing again.
+static bool isComputed(Node *node) {
+    switch (node->kind) {
+        case N_BINARY:
+        case N_UNARY:
+        case N_AND:
+        case N_OR:
+            return isPure(node);
+        default:
+            return false;
+    }
+}
+
+static bool sameExpression(Node *a, Node *b) {
+    if (a == NULL || b == NULL) return a == b;
+    if (a->kind != b->kind || a->op != b->op) return false;
+    switch (a->kind) {
+        case N_CONSTANT:
+            return valuesIdentical(a->value, b->value);
+        case N_GET_LOCAL:
+            return a->var == b->var;
+        case N_BINARY:
+        case N_UNARY:
+        case N_AND:
+        case N_OR:
+            return sameExpression(a->a, b->a) && sameExpression(a->b, b->b);
+        default:
+            return false;
+    }
+}
+
+static bool assigns(Node *node, int var) {
+    if (node == NULL) return false;
+    if ((node->kind == N_SET_LOCAL || node->kind == N_LET) && node->var == var) return true;
+    if (assigns(node->a, var) || assigns(node->b, var) || assigns(node->c, var)) return true;
+    for (int i = 0; i < node->count; i++) {
+        if (assigns(node->items[i], var)) return true;
+    }
+    return false;
+}
+
+static void countUses(Optimizer *optimizer, Node *node) {
+    if (node == NULL) return;
+    if (node->kind == N_GET_LOCAL) optimizer->reads[node->var]++;
+    if (node->kind == N_SET_LOCAL) optimizer->writes[node->var]++;
+    countUses(optimizer, node->a);
+    countUses(optimizer, node->b);
+    countUses(optimizer, node->c);
+    for (int i = 0; i < node->count; i++) countUses(optimizer, node->items[i]);
+}
+
+// Turns every read of `var` into a copy of `value`, which is a constant or
+// another local. Returns how many reads were replaced.
+static int replaceReads(Node *node, int var, Node *value) {
+    if (node == NULL) return 0;
+    if (node->kind == N_GET_LOCAL && node->var == var) {
+        node->kind = value->kind;
+        node->var = value->var;
+        node->value = value->value;
+        node->type = value->type;
+        return 1;
+    }
+    int replaced = replaceReads(node->a, var, value) + replaceReads(node->b, var, value) +
+                   replaceReads(node->c, var, value);
+    for (int i = 0; i < node->count; i++) replaced += replaceReads(node->items[i], var, value);
+    return replaced;
+}
+
+// Moves an expression into a new node and turns the original into a read
+// of `var`, which will hold its value.
+static Node *replaceWithLocal(Optimizer *optimizer, Node *node, int var) {
+    Node *moved = newNode(optimizer->ir, node->kind, node->line);
+    Node *allNext = moved->allNext;
+    *moved = *node;
+    moved->allNext = allNext;
+    node->kind = N_GET_LOCAL;
+    node->var = var;
+    node->op = 0;
+    node->a = NULL;
+    node->b = NULL;
+    return moved;
+}
+
+static Node *newLet(Optimizer *optimizer, int var, Node *value) {
+    Node *let = newNode(optimizer->ir, N_LET, value->line);
+    let->var = var;
+    let->a = value;
+    return let;
+}
+
+// Folds an operator applied to two constants the way run() would apply it,
+// down to integer overflow promoting to a double. Returns false for
+// operations that would fail at runtime, which are left to fail there.
+static bool foldBinary(Optimizer *optimizer, int op, Value a, Value b, Value *result) {
+    if (op == T_EQ || op == T_NE) {
+        // Strings may be flattened to compare, so only plain values fold.
+        if (IS_OBJ(a) || IS_OBJ(b)) return false;
+        bool equal = valuesEqual(optimizer->vm, a, b);
+        *result = BOOL_VAL(op == T_EQ ? equal : !equal);
+        return true;
+    }
+    if (!IS_NUMERIC(a) || !IS_NUMERIC(b)) return false;
+    bool ints = IS_INT(a) && IS_INT(b);
+    int64_t folded;
+    switch (op) {
+        case T_PLUS:
+            if (ints && !__builtin_add_overflow(AS_INT(a), AS_INT(b), &folded)) {
+                *result = INT_VAL(folded);
+            } else {
+                *result = NUM_VAL(asDouble(a) + asDouble(b));
+            }
+            return true;
+        case T_MINUS:
+            if (ints && !__builtin_sub_overflow(AS_INT(a), AS_INT(b), &folded)) {
+                *result = INT_VAL(folded);
+            } else {
+                *result = NUM_VAL(asDouble(a) - asDouble(b));
+            }
+            return true;
+        case T_ASTERISK:
+            if (ints && !__builtin_mul_overflow(AS_INT(a), AS_INT(b), &folded)) {
+                *result = INT_VAL(folded);
+            } else {
+                *result = NUM_VAL(asDouble(a) * asDouble(b));
+            }
+            return true;
+        case T_SLASH:
+            *result = NUM_VAL(asDouble(a) / asDouble(b));
+            return true;
+        // `>=` and `<=` compile to the opposite comparison and a not, which
+        // differs from the direct comparison when either side is NaN.
+        case T_LT:
+        case T_GTE: {
+            bool less = ints ? AS_INT(a) < AS_INT(b) : asDouble(a) < asDouble(b);
+            *result = BOOL_VAL(op == T_LT ? less : !less);
+            return true;
+        }
+        case T_GT:
+        case T_LTE: {
+            bool greater = ints ? AS_INT(a) > AS_INT(b) : asDouble(a) > asDouble(b);
+            *result = BOOL_VAL(op == T_GT ? greater : !greater);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+static bool foldUnary(int op, Value a, Value *result) {
+    if (op == T_BANG) {
+        *result = BOOL_VAL(isFalsey(a));
+        return true;
+    }
+    if (IS_INT(a) && AS_INT(a) != INT64_MIN) {
+        *result = INT_VAL(-AS_INT(a));
+        return true;
+    }
+    if (!IS_NUMERIC(a)) return false;
+    *result = NUM_VAL(-asDouble(a));
+    return true;
+}
+
+static Node *folded(Optimizer *optimizer, Node *node, Value value) {
+    optimizer->changed = true;
+    return newConstant(optimizer->ir, value, node->line);
+}
+
+static Node *simplify(Optimizer *optimizer, Node *node);
+
+static Node *simplifyBlock(Optimizer *optimizer, Node *block) {
+    for (int i = 0; i < block->count; i++) {
+        Node *item = simplify(optimizer, block->items[i]);
+        if (item == NULL || (item->kind == N_BLOCK && item->count == 0)) {
+            removeItem(block, i--);
+            optimizer->changed = true;
+            continue;
+        }
+        block->items[i] = item;
+        if (item->kind == N_RETURN && i + 1 < block->count) {
+            // Nothing after a return runs.
+            block->count = i + 1;
+            optimizer->changed = true;
+        }
+    }
+
+    // A local that is never assigned after its declaration can be replaced
+    // by its initial value where that is a constant, or a local that is not
+    // assigned either for as long as this one is in scope.
+    for (int i = 0; i < block->count; i++) {
+        Node *let = block->items[i];
+        if (let->kind != N_LET || optimizer->writes[let->var] != 0) continue;
+        Node *value = let->a;
+        bool propagate = isConstant(value) && !IS_OBJ(value->value);
+        if (value->kind == N_GET_LOCAL && value->var != let->var) {
+            propagate = true;
+            for (int j = i + 1; j < block->count && propagate; j++) {
+                if (assigns(block->items[j], value->var)) propagate = false;
+            }
+        }
+        if (propagate && optimizer->reads[let->var] > 0) {
+            int replaced = 0;
+            for (int j = i + 1; j < block->count; j++) {
+                replaced += replaceReads(block->items[j], let->var, value);
+            }
+            optimizer->reads[let->var] -= replaced;
+            if (value->kind == N_GET_LOCAL) optimizer->reads[value->var] += replaced;
+            if (replaced > 0) optimizer->changed = true;
+        }
+        if (optimizer->reads[let->var] == 0) {
+            // Nothing reads the local, so only the value's effects remain.
+            optimizer->changed = true;
+            if (isPure(value)) {
+                removeItem(block, i--);
+            } else {
+                let->kind = N_EXPRESSION;
+            }
+        }
+    }
+    return block;
+}
+
+static void simplifyChildren(Optimizer *optimizer, Node *node) {
+    if (node->a != NULL) node->a = simplify(optimizer, node->a);
+    if (node->b != NULL) node->b = simplify(optimizer, node->b);
+    if (node->c != NULL) node->c = simplify(optimizer, node->c);
+    for (int i = 0; i < node->count; i++) node->items[i] = simplify(optimizer, node->items[i]);
+}
+
+// Returns the simplified node, or NULL for a statement that does nothing.
+// Expressions and blocks never simplify to NULL.
+static Node *simplify(Optimizer *optimizer, Node *node) {
+    Value value;
+    switch (node->kind) {
+        case N_BINARY:
+            simplifyChildren(optimizer, node);
+            if (isConstant(node->a) && isConstant(node->b) &&
+                foldBinary(optimizer, node->op, node->a->value, node->b->value, &value)) {
+                return folded(optimizer, node, value);
+            }
+            return node;
+        case N_UNARY:
+            simplifyChildren(optimizer, node);
+            if (isConstant(node->a) && foldUnary(node->op, node->a->value, &value)) {
+                return folded(optimizer, node, value);
+            }
+            return node;
+        case N_AND:
+        case N_OR:
+            node->a = simplify(optimizer, node->a);
+            if (isConstant(node->a)) {
+                // The left operand decides whether the right one runs.
+                optimizer->changed = true;
+                bool skips = isFalsey(node->a->value) == (node->kind == N_AND);
+                return skips ? node->a : simplify(optimizer, node->b);
+            }
+            node->b = simplify(optimizer, node->b);
+            return node;
+        case N_EXPRESSION:
+            simplifyChildren(optimizer, node);
+            if (isPure(node->a)) {
+                optimizer->changed = true;
+                return NULL;
+            }
+            return node;
+        case N_BLOCK:
+            return simplifyBlock(optimizer, node);
+        case N_IF:
+            node->a = simplify(optimizer, node->a);
+            if (isConstant(node->a)) {
+                optimizer->changed = true;
+                Node *taken = isFalsey(node->a->value) ? node->c : node->b;
+                return taken != NULL ? simplify(optimizer, taken) : NULL;
+            }
+            node->b = simplify(optimizer, node->b);
+            if (node->c != NULL) node->c = simplify(optimizer, node->c);
+            return node;
+        case N_WHILE:
+            node->a = simplify(optimizer, node->a);
+            if (isConstant(node->a) && isFalsey(node->a->value)) {
+                optimizer->changed = true;
+                return NULL;
+            }
+            node->b = simplify(optimizer, node->b);
+            return node;
+        default:
+            simplifyChildren(optimizer, node);
+            return node;
+    }
+}
+
+static Node *simplifyAll(Optimizer *optimizer, Node *root) {
+    for (int round = 0; round < SIMPLIFY_ROUNDS; round++) {
+        int count = optimizer->ir->varCount;
+        optimizer->reads = calloc(count + 1, sizeof(int));
+        optimizer->writes = calloc(count + 1, sizeof(int));
+        if (optimizer->reads == NULL || optimizer->writes == NULL) exit(1);
+        countUses(optimizer, root);
+        optimizer->changed = false;
+        root = simplify(optimizer, root);
+        free(optimizer->reads);
+        free(optimizer->writes);
+        if (!optimizer->changed) break;
+    }
+    return root;
+}
+
+// Every expression computed inside a loop whose value cannot change from
+// one iteration to the next, with the locals it holds them in.
+typedef struct {
+    Node **values;
+    int *vars;
+    int count;
+    int capacity;
+} Hoisted;
+
+static bool hasRoomForLocal(Optimizer *optimizer) {
+    // Slots are only handed out as the tree is emitted, but no more locals
+    // can be live at once than there are locals in total.
+    return optimizer->ir->varCount < UINT8_COUNT;
+}
+
+// Replaces `node` by a read of the local holding the same value, adding
+// one if there is none yet.
+static void hoist(Optimizer *optimizer, Hoisted *hoisted, Node *node) {
+    for (int i = 0; i < hoisted->count; i++) {
+        if (sameExpression(hoisted->values[i], node)) {
+            StaticType type = node->type;
+            replaceWithLocal(optimizer, node, hoisted->vars[i]);
+            node->type = type;
+            return;
+        }
+    }
+    if (!hasRoomForLocal(optimizer)) return;
+    if (hoisted->count == hoisted->capacity) {
+        hoisted->capacity = hoisted->capacity < 4 ? 4 : hoisted->capacity * 2;
+        hoisted->values = realloc(hoisted->values, sizeof(Node *) * hoisted->capacity);
+        hoisted->vars = realloc(hoisted->vars, sizeof(int) * hoisted->capacity);
+        if (hoisted->values == NULL || hoisted->vars == NULL) exit(1);
+    }
+    int var = newVar(optimizer->ir, true);
+    StaticType type = node->type;
+    hoisted->values[hoisted->count] = replaceWithLocal(optimizer, node, var);
+    hoisted->vars[hoisted->count++] = var;
+    node->type = type;
+}
+
+static void markVaried(Node *node, bool *varies) {
+    if (node == NULL) return;
+    if (node->kind == N_SET_LOCAL || node->kind == N_LET) varies[node->var] = true;
+    markVaried(node->a, varies);
+    markVaried(node->b, varies);
+    markVaried(node->c, varies);
+    for (int i = 0; i < node->count; i++) markVaried(node->items[i], varies);
+}
+
+static bool isInvariant(Node *node, const bool *varies) {
+    if (node == NULL) return true;
+    if (node->kind == N_GET_LOCAL) return !varies[node->var];
+    return isInvariant(node->a, varies) && isInvariant(node->b, varies);
+}
+
+static void hoistInvariants(Optimizer *optimizer, Hoisted *hoisted, Node *node, const bool *varies) {
+    if (node == NULL) return;
+    if (isComputed(node) && isInvariant(node, varies)) {
+        hoist(optimizer, hoisted, node);
+        return;
+    }
+    hoistInvariants(optimizer, hoisted, node->a, varies);
+    hoistInvariants(optimizer, hoisted, node->b, varies);
+    hoistInvariants(optimizer, hoisted, node->c, varies);
+    for (int i = 0; i < node->count; i++) hoistInvariants(optimizer, hoisted, node->items[i], varies);
+}
+
+// Computes the invariant expressions of the loop at block->items[index]
+// into hidden locals declared just before it. Locals assigned or declared
+// anywhere in the loop may change between iterations. Returns how many
+// declarations were inserted.
+static int hoistLoop(Optimizer *optimizer, Node *block, int index) {
+    Node *loop = block->items[index];
+    bool *varies = calloc(optimizer->ir->varCount + 1, sizeof(bool));
+    if (varies == NULL) exit(1);
+    markVaried(loop, varies);
+    Hoisted hoisted = {NULL, NULL, 0, 0};
+    hoistInvariants(optimizer, &hoisted, loop->a, varies);
+    hoistInvariants(optimizer, &hoisted, loop->b, varies);
+    for (int i = 0; i < hoisted.count; i++) {
+        insertItem(block, index + i, newLet(optimizer, hoisted.vars[i], hoisted.values[i]));
+    }
+    int count = hoisted.count;
+    free(hoisted.values);
+    free(hoisted.vars);
+    free(varies);
+    return count;
+}
+
+// Inner loops go first, so what they hoist can move further out.
+static void hoistLoops(Optimizer *optimizer, Node *block) {
+    for (int i = 0; i < block->count; i++) {
+        Node *item = block->items[i];
+        switch (item->kind) {
+            case N_BLOCK:
+                hoistLoops(optimizer, item);
+                break;
+            case N_IF:
+                hoistLoops(optimizer, item->b);
+                if (item->c != NULL) hoistLoops(optimizer, item->c);
+                break;
+            case N_WHILE:
+                hoistLoops(optimizer, item->b);
+                i += hoistLoop(optimizer, block, i);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Globals a loop reads, each kept in a hidden local while it runs.
+typedef struct {
+    ObjString **names;
+    int *vars;
+    int count;
+    int capacity;
+} Cached;
+
+// A global that exists before the tree runs, so reading it ahead of the
+// loop cannot fail where the loop itself would not have. Globals are never
+// removed once defined.
+static bool isDefined(Optimizer *optimizer, ObjString *name) {
+    Value value;
+    return tableGet(&optimizer->vm->globals, name, &value) || tableGet(optimizer->defined, name, &value);
+}
+
+static bool hasCall(Node *node) {
+    if (node == NULL) return false;
+    if (node->kind == N_CALL) return true;
+    if (hasCall(node->a) || hasCall(node->b) || hasCall(node->c)) return true;
+    for (int i = 0; i < node->count; i++) {
+        if (hasCall(node->items[i])) return true;
+    }
+    return false;
+}
+
+static bool assignsGlobal(Node *node, ObjString *name) {
+    if (node == NULL) return false;
+    if (node->kind == N_SET_GLOBAL && node->name == name) return true;
+    if (assignsGlobal(node->a, name) || assignsGlobal(node->b, name) || assignsGlobal(node->c, name)) return true;
+    for (int i = 0; i < node->count; i++) {
+        if (assignsGlobal(node->items[i], name)) return true;
+    }
+    return false;
+}
+
+// Turns every read in `node` of a defined global that `loop` never assigns
+// into a read of the hidden local caching it.
+static void cacheGlobals(Optimizer *optimizer, Node *loop, Node *node, Cached *cached) {
+    if (node == NULL) return;
+    if (node->kind == N_GET_GLOBAL && isDefined(optimizer, node->name)) {
+        int entry = 0;
+        while (entry < cached->count && cached->names[entry] != node->name) entry++;
+        if (entry == cached->count) {
+            if (!hasRoomForLocal(optimizer) || assignsGlobal(loop, node->name)) return;
+            if (cached->count == cached->capacity) {
+                cached->capacity = cached->capacity < 4 ? 4 : cached->capacity * 2;
+                cached->names = realloc(cached->names, sizeof(ObjString *) * cached->capacity);
+                cached->vars = realloc(cached->vars, sizeof(int) * cached->capacity);
+                if (cached->names == NULL || cached->vars == NULL) exit(1);
+            }
+            cached->names[entry] = node->name;
+            cached->vars[entry] = newVar(optimizer->ir, true);
+            cached->count++;
+        }
+        node->kind = N_GET_LOCAL;
+        node->var = cached->vars[entry];
+    }
+    cacheGlobals(optimizer, loop, node->a, cached);
+    cacheGlobals(optimizer, loop, node->b, cached);
+    cacheGlobals(optimizer, loop, node->c, cached);
+    for (int i = 0; i < node->count; i++) cacheGlobals(optimizer, loop, node->items[i], cached);
+}
+
+// Loads the globals the loop at block->items[index] only reads into hidden
+// locals before it starts. Returns how many statements were inserted.
+static int cacheLoop(Optimizer *optimizer, Node *block, int index) {
+    Node *loop = block->items[index];
+    Cached cached = {NULL, NULL, 0, 0};
+    cacheGlobals(optimizer, loop, loop, &cached);
+    for (int i = 0; i < cached.count; i++) {
+        Node *load = newNode(optimizer->ir, N_GET_GLOBAL, loop->line);
+        load->name = cached.names[i];
+        insertItem(block, index + i, newLet(optimizer, cached.vars[i], load));
+    }
+    int count = cached.count;
+    free(cached.names);
+    free(cached.vars);
+    return count;
+}
+
+// Outer loops go first, since caching a global there covers the loops
+// inside too; inner loops may then still cache globals the outer one
+// assigns. Globals a loop assigns are left in place, so the loop's
+// assignments land however it ends. A call could assign any global, so
+// loops with one are left as they are.
+static void cacheLoops(Optimizer *optimizer, Node *block) {
+    for (int i = 0; i < block->count; i++) {
+        Node *item = block->items[i];
+        switch (item->kind) {
+            case N_BLOCK:
+                cacheLoops(optimizer, item);
+                break;
+            case N_IF:
+                cacheLoops(optimizer, item->b);
+                if (item->c != NULL) cacheLoops(optimizer, item->c);
+                break;
+            case N_WHILE:
+                if (!hasCall(item)) i += cacheLoop(optimizer, block, i);
+                if (item->b->kind == N_BLOCK) cacheLoops(optimizer, item->b);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Pure expressions in `node`, larger ones before the ones inside them.
+static void collectComputed(Node *node, const bool *assigned, Hoisted *found) {
+    if (node == NULL) return;
+    if (isComputed(node) && isInvariant(node, assigned)) {
+        if (found->count == found->capacity) {
+            found->capacity = found->capacity < 8 ? 8 : found->capacity * 2;
+            found->values = realloc(found->values, sizeof(Node *) * found->capacity);
+            if (found->values == NULL) exit(1);
+        }
+        found->values[found->count++] = node;
+    }
+    collectComputed(node->a, assigned, found);
+    collectComputed(node->b, assigned, found);
+    collectComputed(node->c, assigned, found);
+    for (int i = 0; i < node->count; i++) collectComputed(node->items[i], assigned, found);
+}
+
+// Finds a pure expression that occurs more than once in `expression`,
+// computes it into a hidden local declared before block->items[index] and
+// reads that local instead. Returns false if there is none.
+static bool shareCommon(Optimizer *optimizer, Node *block, int index, Node *expression) {
+    // Locals assigned within the statement may differ between occurrences.
+    bool *assigned = calloc(optimizer->ir->varCount + 1, sizeof(bool));
+    if (assigned == NULL) exit(1);
+    markVaried(expression, assigned);
+    Hoisted found = {NULL, NULL, 0, 0};
+    collectComputed(expression, assigned, &found);
+
+    bool shared = false;
+    for (int i = 0; i < found.count && !shared; i++) {
+        for (int j = i + 1; j < found.count && !shared; j++) {
+            if (!sameExpression(found.values[i], found.values[j]) || !hasRoomForLocal(optimizer)) continue;
+            int var = newVar(optimizer->ir, true);
+            Node *first = found.values[i];
+            StaticType type = first->type;
+            // Later copies are still intact, so compare them before the
+            // first becomes a read of the local.
+            for (int k = j; k < found.count; k++) {
+                if (!sameExpression(first, found.values[k])) continue;
+                replaceWithLocal(optimizer, found.values[k], var);
+                found.values[k]->type = type;
+            }
+            Node *value = replaceWithLocal(optimizer, first, var);
+            first->type = type;
+            insertItem(block, index, newLet(optimizer, var, value));
+            shared = true;
+        }
+    }
+    free(found.values);
+    free(assigned);
+    return shared;
+}
+
+static void shareBlock(Optimizer *optimizer, Node *block) {
+    for (int i = 0; i < block->count; i++) {
+        Node *item = block->items[i];
+        switch (item->kind) {
+            case N_BLOCK:
+                shareBlock(optimizer, item);
+                break;
+            case N_IF:
+                shareBlock(optimizer, item->b);
+                if (item->c != NULL) shareBlock(optimizer, item->c);
+                break;
+            case N_WHILE:
+                // The condition runs on every iteration, so anything shared
+                // would have to be computed in the loop anyway.
+                shareBlock(optimizer, item->b);
+                continue;
+            default:
+                break;
+        }
+        // Only expressions evaluated once per run of the statement; a
+        // branch or a loop body is a block of its own.
+        if (item->kind == N_BLOCK || item->a == NULL) continue;
+        while (shareCommon(optimizer, block, i, item->a)) i++;
+    }
+}
+
+Node *optimize(VM *vm, Ir *ir, Node *root, Table *defined) {
+    Optimizer optimizer;
+    optimizer.vm = vm;
+    optimizer.ir = ir;
+    optimizer.defined = defined;
+    root = simplifyAll(&optimizer, root);
+    if (root->kind == N_BLOCK) {
+        cacheLoops(&optimizer, root);
+        // Moving code needs to know which expressions cannot fail.
+        inferTypes(ir, root);
+        hoistLoops(&optimizer, root);
+        shareBlock(&optimizer, root);
+        root = simplifyAll(&optimizer, root);
+    }
+    inferTypes(ir, root);
+    return root;
+}
@@ -0,0 +1,29 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#ifndef CSCRIPTY_OPTIMIZER_H
+#define CSCRIPTY_OPTIMIZER_H
+
+#include "ir.h"
+#include "table.h"
+
+// Rewrites the tree of one function, top-level declaration or expression
+// and returns its new root:
+//  - folds constant operations and branches, and drops unreachable code and
+//    statements without effects,
+//  - replaces locals that only ever hold a constant or a copy of another
+//    local with that value,
+//  - moves pure expressions that do not change inside a loop in front of it,
+//    and computes pure expressions repeated in a statement once,
+//  - reads the globals a loop never assigns from hidden locals loaded
+//    before it. Only globals already in vm->globals or in `defined`
+//    qualify, and loops that call are skipped.
+// Only expressions that cannot fail are ever moved or dropped, so scripts
+// report the same errors at the same points. A loop suspended by the budget
+// keeps the values it loaded, so it does not see globals that other code
+// sharing the VM assigns while it waits.
+// Types are inferred afresh before returning.
+Node *optimize(VM *vm, Ir *ir, Node *root, Table *defined);
+
+#endif //CSCRIPTY_OPTIMIZER_H
@@ -0,0 +1,125 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "profiler.h"
+#include "debug.h"
+
+#define REPORT_LINES 20
+
+void initProfiler(Profiler *profiler, const char *name) {
+    memset(profiler, 0, sizeof(Profiler));
+    profiler->name = name;
+    profiler->lastOp = -1;
+}
+
+void freeProfiler(Profiler *profiler) {
+    free(profiler->lines);
+    initProfiler(profiler, profiler->name);
+}
+
+static void charge(Profiler *profiler, uint64_t now) {
+    if (profiler->lastOp < 0) return;
+    uint64_t elapsed = now - profiler->lastCycles;
+    profiler->ops[profiler->lastOp].count++;
+    profiler->ops[profiler->lastOp].cycles += elapsed;
+    profiler->lines[profiler->lastLine].count++;
+    profiler->lines[profiler->lastLine].cycles += elapsed;
+}
+
+void profileInstruction(Profiler *profiler, uint8_t op, int line) {
+    uint64_t now = readCycles();
+    charge(profiler, now);
+
+    if (line >= profiler->lineCapacity) {
+        int oldCap = profiler->lineCapacity;
+        int capacity = oldCap < 64 ? 64 : oldCap;
+        while (capacity <= line) capacity *= 2;
+        profiler->lines = realloc(profiler->lines, sizeof(ProfileCounter) * capacity);
+        if (profiler->lines == NULL) exit(1);
+        memset(profiler->lines + oldCap, 0, sizeof(ProfileCounter) * (capacity - oldCap));
+        profiler->lineCapacity = capacity;
+    }
+    profiler->lastOp = op;
+    profiler->lastLine = line;
+    profiler->lastCycles = now;
+}
+
+void profileStop(Profiler *profiler) {
+    charge(profiler, readCycles());
+    profiler->lastOp = -1;
+}
+
+typedef struct {
+    int index;
+    uint64_t cycles;
+} Ranked;
+
+static int compareCycles(const void *a, const void *b) {
+    uint64_t ca = ((const Ranked *) a)->cycles;
+    uint64_t cb = ((const Ranked *) b)->cycles;
+    return ca < cb ? 1 : ca > cb ? -1 : 0;
+}
+
+static int rank(ProfileCounter *counters, int count, Ranked *ranked) {
+    int used = 0;
+    for (int i = 0; i < count; i++) {
+        if (counters[i].count == 0) continue;
+        ranked[used].index = i;
+        ranked[used].cycles = counters[i].cycles;
+        used++;
+    }
+    qsort(ranked, used, sizeof(Ranked), compareCycles);
+    return used;
+}
+
+static void writeRow(FILE *out, const char *label, ProfileCounter *counter, uint64_t total) {
+    fprintf(out, "%-10s %14llu %16llu %10.1f %6.2f%%\n", label,
+            (unsigned long long) counter->count, (unsigned long long) counter->cycles,
+            (double) counter->cycles / (double) counter->count, 100.0 * (double) counter->cycles / (double) total);
+}
+
+void writeProfileReport(Profiler *profiler, FILE *out) {
+    uint64_t total = 0;
+    uint64_t executed = 0;
+    for (int i = 0; i < UINT8_COUNT; i++) {
+        total += profiler->ops[i].cycles;
+        executed += profiler->ops[i].count;
+    }
+    if (total == 0) total = 1;
+
+    fprintf(out, "== profile: %s, %llu instructions ==\n", profiler->name, (unsigned long long) executed);
+    fprintf(out, "%-10s %14s %16s %10s %7s\n", "opcode", "count", "cycles", "cyc/op", "time");
+    Ranked ops[UINT8_COUNT];
+    int used = rank(profiler->ops, UINT8_COUNT, ops);
+    for (int i = 0; i < used; i++) {
+        writeRow(out, opName((uint8_t) ops[i].index), &profiler->ops[ops[i].index], total);
+    }
+
+    fprintf(out, "%-10s %14s %16s %10s %7s\n", "line", "count", "cycles", "cyc/op", "time");
+    Ranked *lines = malloc(sizeof(Ranked) * (profiler->lineCapacity + 1));
+    if (lines == NULL) exit(1);
+    used = rank(profiler->lines, profiler->lineCapacity, lines);
+    for (int i = 0; i < used && i < REPORT_LINES; i++) {
+        char label[16];
+        snprintf(label, sizeof(label), "%d", lines[i].index);
+        writeRow(out, label, &profiler->lines[lines[i].index], total);
+    }
+    free(lines);
+}
+
+// One `script;line N cycles` entry per executed line, the input format of
+// flamegraph.pl and speedscope.
+bool writeFoldedStacks(Profiler *profiler, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) return false;
+    for (int line = 0; line < profiler->lineCapacity; line++) {
+        if (profiler->lines[line].count == 0) continue;
+        fprintf(file, "%s;line %d %llu\n", profiler->name, line,
+                (unsigned long long) profiler->lines[line].cycles);
+    }
+    fclose(file);
+    return true;
+}
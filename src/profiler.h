@@ -0,0 +1,55 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#ifndef CSCRIPTY_PROFILER_H
+#define CSCRIPTY_PROFILER_H
+
+#include <stdio.h>
+#include <time.h>
+#include "common.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+typedef struct {
+    uint64_t count;
+    uint64_t cycles;
+} ProfileCounter;
+
+// Per-opcode and per-line execution counts. Each instruction is charged
+// the cycles that elapse until the next one starts.
+typedef struct {
+    const char *name;
+    ProfileCounter ops[UINT8_COUNT];
+    ProfileCounter *lines;
+    int lineCapacity;
+    uint64_t lastCycles;
+    int lastOp;
+    int lastLine;
+} Profiler;
+
+static inline uint64_t readCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+void initProfiler(Profiler *profiler, const char *name);
+
+void freeProfiler(Profiler *profiler);
+
+void profileInstruction(Profiler *profiler, uint8_t op, int line);
+
+void profileStop(Profiler *profiler);
+
+void writeProfileReport(Profiler *profiler, FILE *out);
+
+bool writeFoldedStacks(Profiler *profiler, const char *path);
+
+#endif //CSCRIPTY_PROFILER_H
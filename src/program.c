@@ -0,0 +1,83 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#include <string.h>
+#include "program.h"
+#include "memory.h"
+#include "object.h"
+
+Program *compileProgram(VM *vm, const char *source, bool expression) {
+    ExecContext *context = expression ? newExpressionContext(vm, source) : newContext(vm, source);
+    if (context == NULL) return NULL;
+    Program *program = ALLOCATE(vm, MEM_CODE, Program, 1);
+    program->context = context;
+    program->expression = expression;
+    return program;
+}
+
+void freeProgram(VM *vm, Program *program) {
+    freeContext(vm, program->context);
+    FREE(vm, MEM_CODE, Program, program);
+}
+
+InterpretResult runProgram(VM *vm, Program *program, Value *result) {
+    ExecContext *context = program->context;
+    rewindContext(context);
+    setBudget(vm, vm->budget, vm->preempt);
+
+    InterpretResult status = runContext(vm, context);
+    if (result != NULL) {
+        *result = status == OK && program->expression ? context->stackTop[-1] : NULL_VAL;
+    }
+    return status;
+}
+
+InterpretResult runProgramBatch(VM *vm, Program *program, GlobalHandle *inputs, int inputCount,
+                                const Value *rows, int rowCount, Value *results, int *rowsRun) {
+    InterpretResult status = OK;
+    int row = 0;
+    for (; row < rowCount; row++) {
+        const Value *values = rows + (size_t) row * inputCount;
+        for (int i = 0; i < inputCount; i++) {
+            setGlobal(vm, &inputs[i], values[i]);
+        }
+        status = runProgram(vm, program, results != NULL ? &results[row] : NULL);
+        if (status != OK) break;
+    }
+    if (rowsRun != NULL) *rowsRun = row;
+    return status;
+}
+
+void resolveGlobal(VM *vm, GlobalHandle *handle, const char *name) {
+    handle->name = copyString(vm, name, (int) strlen(name));
+    handle->entries = vm->globals.entries;
+    handle->entry = tableFindEntry(&vm->globals, handle->name);
+}
+
+// The cached slot is stale once the table has been reallocated or the
+// global was deleted after a failed assignment.
+static bool handleValid(VM *vm, GlobalHandle *handle) {
+    return handle->entry != NULL && handle->entries == vm->globals.entries &&
+           handle->entry->key == handle->name;
+}
+
+void setGlobal(VM *vm, GlobalHandle *handle, Value value) {
+    if (handleValid(vm, handle)) {
+        handle->entry->value = value;
+        return;
+    }
+    tableSet(vm, &vm->globals, handle->name, value);
+    handle->entries = vm->globals.entries;
+    handle->entry = tableFindEntry(&vm->globals, handle->name);
+}
+
+bool getGlobal(VM *vm, GlobalHandle *handle, Value *value) {
+    if (!handleValid(vm, handle)) {
+        handle->entries = vm->globals.entries;
+        handle->entry = tableFindEntry(&vm->globals, handle->name);
+        if (handle->entry == NULL) return false;
+    }
+    *value = handle->entry->value;
+    return true;
+}
@@ -0,0 +1,50 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#ifndef CSCRIPTY_PROGRAM_H
+#define CSCRIPTY_PROGRAM_H
+
+#include "common.h"
+#include "vm.h"
+
+// A script compiled once and run any number of times against the globals
+// of the VM it was compiled for.
+typedef struct {
+    ExecContext *context;
+    bool expression;
+} Program;
+
+// A global variable resolved ahead of time. The slot in vm->globals is
+// cached, so setting or reading it does not probe the table until the
+// table grows.
+typedef struct {
+    ObjString *name;
+    Entry *entry;
+    Entry *entries;
+} GlobalHandle;
+
+// Compiles `source` as statements, or as a single expression whose value
+// runProgram() returns. Returns NULL after reporting a compile error.
+Program *compileProgram(VM *vm, const char *source, bool expression);
+
+void freeProgram(VM *vm, Program *program);
+
+// Runs the program from the start. `result` receives the expression's value,
+// or nil for statements and failed runs, and may be NULL.
+InterpretResult runProgram(VM *vm, Program *program, Value *result);
+
+// Runs the program once per row. Row `i` supplies values for `inputs` from
+// rows[i * inputCount]; its result goes to results[i]. Stops at the first
+// row that does not finish OK, with the number of rows run in `rowsRun`.
+InterpretResult runProgramBatch(VM *vm, Program *program, GlobalHandle *inputs, int inputCount,
+                                const Value *rows, int rowCount, Value *results, int *rowsRun);
+
+void resolveGlobal(VM *vm, GlobalHandle *handle, const char *name);
+
+// Defines the global if it does not exist yet.
+void setGlobal(VM *vm, GlobalHandle *handle, Value value);
+
+bool getGlobal(VM *vm, GlobalHandle *handle, Value *value);
+
+#endif //CSCRIPTY_PROGRAM_H
@@ -0,0 +1,133 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "sampler.h"
+#include "vm.h"
+
+// Line 0 collects samples taken outside run(), e.g. while compiling.
+static VM *volatile sampledVM = NULL;
+static int *samples = NULL;
+static atomic_uint sampleCount;
+
+static void onProfileSignal(int signal) {
+    (void) signal;
+    VM *vm = sampledVM;
+    if (vm == NULL) return;
+
+    int line = 0;
+    Chunk *chunk = vm->chunk;
+    if (chunk != NULL && chunk->code != NULL) {
+        // ip already points past the opcode being executed.
+        long offset = (long) (vm->ip - chunk->code) - 1;
+        if (offset >= 0 && offset < chunk->count) line = chunk->lines[offset];
+    }
+
+    unsigned int index = atomic_fetch_add_explicit(&sampleCount, 1, memory_order_relaxed);
+    if (index < SAMPLE_CAPACITY) samples[index] = line;
+}
+
+bool startSampler(VM *vm, int hz) {
+    if (hz <= 0 || hz > 1000000) return false;
+    samples = malloc(sizeof(int) * SAMPLE_CAPACITY);
+    if (samples == NULL) return false;
+    atomic_store(&sampleCount, 0);
+    sampledVM = vm;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onProfileSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, NULL) != 0) return false;
+
+    struct itimerval timer;
+    // tv_usec must stay below a second, which 1 Hz alone reaches.
+    int period = 1000000 / hz;
+    timer.it_interval.tv_sec = period / 1000000;
+    timer.it_interval.tv_usec = period % 1000000;
+    timer.it_value = timer.it_interval;
+    return setitimer(ITIMER_PROF, &timer, NULL) == 0;
+}
+
+void stopSampler() {
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+    signal(SIGPROF, SIG_IGN);
+    sampledVM = NULL;
+}
+
+void freeSampler() {
+    free(samples);
+    samples = NULL;
+}
+
+static int countLines(unsigned int taken, int **counts) {
+    int maxLine = 0;
+    for (unsigned int i = 0; i < taken; i++) {
+        if (samples[i] > maxLine) maxLine = samples[i];
+    }
+    *counts = calloc(maxLine + 1, sizeof(int));
+    if (*counts == NULL) exit(1);
+    for (unsigned int i = 0; i < taken; i++) {
+        (*counts)[samples[i]]++;
+    }
+    return maxLine + 1;
+}
+
+static unsigned int samplesTaken() {
+    unsigned int count = atomic_load(&sampleCount);
+    return count < SAMPLE_CAPACITY ? count : SAMPLE_CAPACITY;
+}
+
+void writeSampleReport(const char *name, FILE *out) {
+    unsigned int total = atomic_load(&sampleCount);
+    unsigned int taken = samplesTaken();
+    fprintf(out, "== samples: %s, %u taken", name, total);
+    if (taken < total) fprintf(out, ", %u dropped", total - taken);
+    fprintf(out, " ==\n");
+    if (taken == 0) return;
+
+    int *counts;
+    int lines = countLines(taken, &counts);
+    fprintf(out, "%-10s %10s %7s\n", "line", "samples", "time");
+    // Pick the busiest lines without sorting the whole table.
+    for (int shown = 0; shown < 20; shown++) {
+        int best = -1;
+        for (int line = 0; line < lines; line++) {
+            if (counts[line] > 0 && (best < 0 || counts[line] > counts[best])) best = line;
+        }
+        if (best < 0) break;
+        if (best == 0) {
+            fprintf(out, "%-10s %10d %6.2f%%\n", "(no code)", counts[best], 100.0 * counts[best] / taken);
+        } else {
+            fprintf(out, "%-10d %10d %6.2f%%\n", best, counts[best], 100.0 * counts[best] / taken);
+        }
+        counts[best] = 0;
+    }
+    free(counts);
+}
+
+bool writeSampledStacks(const char *name, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) return false;
+    int *counts;
+    int lines = countLines(samplesTaken(), &counts);
+    for (int line = 0; line < lines; line++) {
+        if (counts[line] == 0) continue;
+        if (line == 0) {
+            fprintf(file, "%s;(no code) %d\n", name, counts[line]);
+        } else {
+            fprintf(file, "%s;line %d %d\n", name, line, counts[line]);
+        }
+    }
+    free(counts);
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,26 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#ifndef CSCRIPTY_SAMPLER_H
+#define CSCRIPTY_SAMPLER_H
+
+#include <stdio.h>
+#include "common.h"
+
+#define SAMPLE_CAPACITY (1 << 20)
+#define SAMPLE_DEFAULT_HZ 1000
+
+// Statistical profiler: a SIGPROF timer samples the source line the VM is
+// executing. Only one VM per process can be sampled at a time.
+bool startSampler(VM *vm, int hz);
+
+void stopSampler();
+
+void writeSampleReport(const char *name, FILE *out);
+
+bool writeSampledStacks(const char *name, const char *path);
+
+void freeSampler();
+
+#endif //CSCRIPTY_SAMPLER_H
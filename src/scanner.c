@@ -6,18 +6,10 @@
 #include "common.h"
 #include "scanner.h"
 
-typedef struct {
-    const char *start;
-    const char *current;
-    int line;
-} Scanner;
-
-Scanner scanner;
-
-void initScanner(const char *source) {
-    scanner.start = source;
-    scanner.current = source;
-    scanner.line = 1;
+void initScanner(Scanner *scanner, const char *source) {
+    scanner->start = source;
+    scanner->current = source;
+    scanner->line = 1;
 }
 
 static bool isAlpha(char c) {
@@ -28,65 +20,65 @@ static bool isDigit(char c) {
     return c >= '0' && c <= '9';
 }
 
-static bool isAtEnd() {
-    return *scanner.current == '\0';
+static bool isAtEnd(Scanner *scanner) {
+    return *scanner->current == '\0';
 }
 
-static char advance() {
-    scanner.current++;
-    return scanner.current[-1];
+static char advance(Scanner *scanner) {
+    scanner->current++;
+    return scanner->current[-1];
 }
 
-static char peek() {
-    return *scanner.current;
+static char peek(Scanner *scanner) {
+    return *scanner->current;
 }
 
-static char peekNext() {
-    if (isAtEnd()) return '\0';
-    return scanner.current[1];
+static char peekNext(Scanner *scanner) {
+    if (isAtEnd(scanner)) return '\0';
+    return scanner->current[1];
 }
 
-static bool match(char expected) {
-    if (isAtEnd()) return false;
-    if (*scanner.current != expected) return false;
-    scanner.current++;
+static bool match(Scanner *scanner, char expected) {
+    if (isAtEnd(scanner)) return false;
+    if (*scanner->current != expected) return false;
+    scanner->current++;
     return true;
 }
 
-static Token makeToken(TokenType type) {
+static Token makeToken(Scanner *scanner, TokenType type) {
     Token token;
     token.type = type;
-    token.start = scanner.start;
-    token.length = (int) (scanner.current - scanner.start);
-    token.line = scanner.line;
+    token.start = scanner->start;
+    token.length = (int) (scanner->current - scanner->start);
+    token.line = scanner->line;
     return token;
 }
 
-static Token errorToken(const char *message) {
+static Token errorToken(Scanner *scanner, const char *message) {
     Token token;
     token.type = T_ERR;
     token.start = message;
     token.length = (int) strlen(message);
-    token.line = scanner.line;
+    token.line = scanner->line;
     return token;
 }
 
-static void skipWhitespace() {
+static void skipWhitespace(Scanner *scanner) {
     for (;;) {
-        char c = peek();
+        char c = peek(scanner);
         switch (c) {
             case ' ':
             case '\r':
             case '\t':
-                advance();
+                advance(scanner);
                 break;
             case '\n':
-                scanner.line++;
-                advance();
+                scanner->line++;
+                advance(scanner);
                 break;
             case '/':
-                if (peekNext() == '/') {
-                    while (peek() != '\n' && !isAtEnd()) advance();
+                if (peekNext(scanner) == '/') {
+                    while (peek(scanner) != '\n' && !isAtEnd(scanner)) advance(scanner);
                 } else {
                     return;
                 }
@@ -97,143 +89,149 @@ static void skipWhitespace() {
     }
 }
 
-static TokenType checkKeyword(int start, int length, const char *rest, TokenType type) {
-    if (scanner.current - scanner.start == start + length &&
-        memcmp(scanner.start + start, rest, length) == 0)
+static TokenType checkKeyword(Scanner *scanner, int start, int length, const char *rest, TokenType type) {
+    if (scanner->current - scanner->start == start + length &&
+        memcmp(scanner->start + start, rest, length) == 0)
         return type;
     return T_IDENT;
 }
 
-static TokenType identifierType() {
-    switch (scanner.start[0]) {
+static TokenType identifierType(Scanner *scanner) {
+    switch (scanner->start[0]) {
         case 'a':
-            return checkKeyword(1, 2, "nd", T_AND);
+            return checkKeyword(scanner, 1, 2, "nd", T_AND);
         case 'c':
-            return checkKeyword(1, 4, "lass", T_CLASS);
+            return checkKeyword(scanner, 1, 4, "lass", T_CLASS);
         case 'e':
-            return checkKeyword(1, 3, "lse", T_ELSE);
+            return checkKeyword(scanner, 1, 3, "lse", T_ELSE);
         case 'f': {
-            if (scanner.current - scanner.start > 1) {
-                switch (scanner.start[1]) {
+            if (scanner->current - scanner->start > 1) {
+                switch (scanner->start[1]) {
                     case 'a':
-                        return checkKeyword(2, 3, "lse", T_FALSE);
+                        return checkKeyword(scanner, 2, 3, "lse", T_FALSE);
                     case 'o':
-                        return checkKeyword(2, 1, "r", T_FOR);
+                        return checkKeyword(scanner, 2, 1, "r", T_FOR);
                     case 'u':
-                        return checkKeyword(2, 1, "n", T_FUN);
+                        return checkKeyword(scanner, 2, 1, "n", T_FUN);
                 }
             }
             break;
         }
         case 'i':
-            return checkKeyword(1, 1, "f", T_IF);
+            return checkKeyword(scanner, 1, 1, "f", T_IF);
         case 'n':
-            return checkKeyword(1, 2, "il", T_NULL);
+            return checkKeyword(scanner, 1, 2, "il", T_NULL);
         case 'o':
-            return checkKeyword(1, 1, "r", T_OR);
+            return checkKeyword(scanner, 1, 1, "r", T_OR);
         case 'p':
-            return checkKeyword(1, 3, "uts", T_PUTS);
+            return checkKeyword(scanner, 1, 3, "uts", T_PUTS);
         case 'r':
-            return checkKeyword(1, 5, "eturn", T_RETURN);
+            return checkKeyword(scanner, 1, 5, "eturn", T_RETURN);
         case 's':
-            return checkKeyword(1, 4, "uper", T_SUPER);
+            return checkKeyword(scanner, 1, 4, "uper", T_SUPER);
         case 't': {
-            if (scanner.current - scanner.start > 1) {
-                switch (scanner.start[1]) {
+            if (scanner->current - scanner->start > 1) {
+                switch (scanner->start[1]) {
                     case 'h':
-                        return checkKeyword(2, 2, "is", T_THIS);
+                        return checkKeyword(scanner, 2, 2, "is", T_THIS);
                     case 'r':
-                        return checkKeyword(2, 2, "ue", T_TRUE);
+                        return checkKeyword(scanner, 2, 2, "ue", T_TRUE);
                 }
             }
             break;
         }
         case 'l':
-            return checkKeyword(1, 2, "et", T_LET);
+            return checkKeyword(scanner, 1, 2, "et", T_LET);
         case 'w':
-            return checkKeyword(1, 4, "hile", T_WHILE);
+            return checkKeyword(scanner, 1, 4, "hile", T_WHILE);
     }
     return T_IDENT;
 }
 
-static Token identifier() {
-    while (isAlpha(peek()) || isDigit(peek())) advance();
+static Token identifier(Scanner *scanner) {
+    while (isAlpha(peek(scanner)) || isDigit(peek(scanner))) advance(scanner);
 
-    return makeToken(identifierType());
+    return makeToken(scanner, identifierType(scanner));
 }
 
-static Token number() {
-    while (isDigit(peek())) advance();
-    if (peek() == '.' && isDigit(peekNext())) {
-        advance();
-        while (isDigit(peek())) advance();
+static Token number(Scanner *scanner) {
+    while (isDigit(peek(scanner))) advance(scanner);
+    if (peek(scanner) == '.' && isDigit(peekNext(scanner))) {
+        advance(scanner);
+        while (isDigit(peek(scanner))) advance(scanner);
     }
 
-    return makeToken(T_NUMBER);
+    return makeToken(scanner, T_NUMBER);
 }
 
-static Token string(bool doubleQuoted) {
-    while (peek() != (doubleQuoted ? '"' : '\'') && !isAtEnd()) {
-        if (peek() == '\n') scanner.line++;
-        advance();
+static Token string(Scanner *scanner, bool doubleQuoted) {
+    while (peek(scanner) != (doubleQuoted ? '"' : '\'') && !isAtEnd(scanner)) {
+        if (peek(scanner) == '\n') scanner->line++;
+        advance(scanner);
     }
-    if (isAtEnd()) return errorToken("Unterminated string.");
-    advance();
-    return makeToken(T_STRING);
-}
-
-Token scanToken() {
-    skipWhitespace();
-    scanner.start = scanner.current;
-    if (isAtEnd()) return makeToken(T_EOF);
-    char c = advance();
-    if (isAlpha(c)) return identifier();
-    if (isDigit(c)) return number();
+    if (isAtEnd(scanner)) return errorToken(scanner, "Unterminated string.");
+    advance(scanner);
+    return makeToken(scanner, T_STRING);
+}
+
+Token scanToken(Scanner *scanner) {
+    skipWhitespace(scanner);
+    scanner->start = scanner->current;
+    if (isAtEnd(scanner)) return makeToken(scanner, T_EOF);
+    char c = advance(scanner);
+    if (isAlpha(c)) return identifier(scanner);
+    if (isDigit(c)) return number(scanner);
     switch (c) {
         case '(':
-            return makeToken(T_LPAREN);
+            return makeToken(scanner, T_LPAREN);
         case ')':
-            return makeToken(T_RPAREN);
+            return makeToken(scanner, T_RPAREN);
         case '{':
-            return makeToken(T_LBRACE);
+            return makeToken(scanner, T_LBRACE);
         case '}':
-            return makeToken(T_RBRACE);
+            return makeToken(scanner, T_RBRACE);
+        case '[':
+            return makeToken(scanner, T_LBRACK);
+        case ']':
+            return makeToken(scanner, T_RBRACK);
         case ';':
-            return makeToken(T_SEMICOLON);
+            return makeToken(scanner, T_SEMICOLON);
+        case ':':
+            return makeToken(scanner, T_COLON);
         case ',':
-            return makeToken(T_COMMA);
+            return makeToken(scanner, T_COMMA);
         case '.':
-            return makeToken(T_DOT);
+            return makeToken(scanner, T_DOT);
         case '-':
-            return makeToken(T_MINUS);
+            return makeToken(scanner, T_MINUS);
         case '+':
-            return makeToken(T_PLUS);
+            return makeToken(scanner, T_PLUS);
         case '/':
-            return makeToken(T_SLASH);
+            return makeToken(scanner, T_SLASH);
         case '*':
-            return makeToken(T_ASTERISK);
+            return makeToken(scanner, T_ASTERISK);
         case '&': {
-            return match('&') ? makeToken(T_AND) : errorToken("Unexpected Character.");
+            return match(scanner, '&') ? makeToken(scanner, T_AND) : errorToken(scanner, "Unexpected Character.");
         }
         case '|': {
-            return match('|') ? makeToken(T_OR) : errorToken("Unexpected Character.");
+            return match(scanner, '|') ? makeToken(scanner, T_OR) : errorToken(scanner, "Unexpected Character.");
         }
         case '!':
-            return makeToken(
-                    match('=') ? T_NE : T_BANG);
+            return makeToken(scanner,
+                    match(scanner, '=') ? T_NE : T_BANG);
         case '=':
-            return makeToken(
-                    match('=') ? T_EQ : T_ASSIGN);
+            return makeToken(scanner,
+                    match(scanner, '=') ? T_EQ : T_ASSIGN);
         case '<':
-            return makeToken(
-                    match('=') ? T_LTE : T_LT);
+            return makeToken(scanner,
+                    match(scanner, '=') ? T_LTE : T_LT);
         case '>':
-            return makeToken(
-                    match('=') ? T_GTE : T_GT);
+            return makeToken(scanner,
+                    match(scanner, '=') ? T_GTE : T_GT);
         case '\'':
-            return string(false);
+            return string(scanner, false);
         case '"':
-            return string(true);
+            return string(scanner, true);
     }
-    return errorToken("Unexpected Character.");
+    return errorToken(scanner, "Unexpected Character.");
 }
@@ -8,8 +8,9 @@
 typedef enum {
     T_LPAREN, T_RPAREN, // ( )
     T_LBRACE, T_RBRACE, // { }
+    T_LBRACK, T_RBRACK, // [ ]
     T_COMMA, T_DOT, T_MINUS, T_PLUS, // , . - +
-    T_SEMICOLON, T_SLASH, T_ASTERISK, // ; / *
+    T_SEMICOLON, T_COLON, T_SLASH, T_ASTERISK, // ; : / *
     T_BANG, T_NE, T_ASSIGN, T_EQ, // ! != = ==
     T_GT, T_GTE, // < <=
     T_LT, T_LTE, // > >=
@@ -28,8 +29,14 @@ typedef struct {
     TokenType type;
 } Token;
 
-void initScanner(const char *source);
+typedef struct {
+    const char *start;
+    const char *current;
+    int line;
+} Scanner;
+
+void initScanner(Scanner *scanner, const char *source);
 
-Token scanToken();
+Token scanToken(Scanner *scanner);
 
 #endif //CSCRIPTY_SCANNER_H
@@ -0,0 +1,143 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scheduler.h"
+
+typedef struct Task {
+    VM vm;
+    char *source;
+    ExecContext *context;
+    TaskDoneFn done;
+    void *data;
+    struct Task *next;
+} Task;
+
+struct Scheduler {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    Task *head;
+    Task *tail;
+    // Tasks spawned and not yet finished, whether queued or running.
+    int live;
+    bool stopping;
+    uint64_t slice;
+    pthread_t *threads;
+    int threadCount;
+};
+
+static void enqueue(Scheduler *scheduler, Task *task) {
+    task->next = NULL;
+    if (scheduler->tail == NULL) {
+        scheduler->head = task;
+    } else {
+        scheduler->tail->next = task;
+    }
+    scheduler->tail = task;
+    pthread_cond_signal(&scheduler->ready);
+}
+
+static Task *dequeue(Scheduler *scheduler) {
+    pthread_mutex_lock(&scheduler->lock);
+    while (scheduler->head == NULL && !(scheduler->stopping && scheduler->live == 0)) {
+        pthread_cond_wait(&scheduler->ready, &scheduler->lock);
+    }
+    Task *task = scheduler->head;
+    if (task != NULL) {
+        scheduler->head = task->next;
+        if (scheduler->head == NULL) scheduler->tail = NULL;
+    }
+    pthread_mutex_unlock(&scheduler->lock);
+    return task;
+}
+
+static void finishTask(Scheduler *scheduler, Task *task, InterpretResult result) {
+    if (task->context != NULL) freeContext(&task->vm, task->context);
+    freeVM(&task->vm);
+    free(task->source);
+    if (task->done != NULL) task->done(task->data, result);
+    free(task);
+
+    pthread_mutex_lock(&scheduler->lock);
+    scheduler->live--;
+    // Idle workers may be waiting for the last task to finish so they can exit.
+    if (scheduler->live == 0) pthread_cond_broadcast(&scheduler->ready);
+    pthread_mutex_unlock(&scheduler->lock);
+}
+
+static void *schedulerMain(void *arg) {
+    Scheduler *scheduler = (Scheduler *) arg;
+    Task *task;
+    while ((task = dequeue(scheduler)) != NULL) {
+        // Compiling happens on the first slice so spawnTask() stays cheap.
+        if (task->context == NULL) {
+            task->context = newContext(&task->vm, task->source);
+            if (task->context == NULL) {
+                finishTask(scheduler, task, COMPILE_ERROR);
+                continue;
+            }
+        }
+
+        InterpretResult result = runContext(&task->vm, task->context);
+        if (result != SUSPENDED) {
+            finishTask(scheduler, task, result);
+            continue;
+        }
+        pthread_mutex_lock(&scheduler->lock);
+        enqueue(scheduler, task);
+        pthread_mutex_unlock(&scheduler->lock);
+    }
+    return NULL;
+}
+
+Scheduler *startScheduler(int workers, uint64_t slice) {
+    Scheduler *scheduler = calloc(1, sizeof(Scheduler));
+    if (scheduler == NULL) exit(1);
+    pthread_mutex_init(&scheduler->lock, NULL);
+    pthread_cond_init(&scheduler->ready, NULL);
+    scheduler->slice = slice;
+    scheduler->threadCount = workers < 1 ? 1 : workers;
+    scheduler->threads = malloc(sizeof(pthread_t) * scheduler->threadCount);
+    if (scheduler->threads == NULL) exit(1);
+    for (int i = 0; i < scheduler->threadCount; i++) {
+        pthread_create(&scheduler->threads[i], NULL, schedulerMain, scheduler);
+    }
+    return scheduler;
+}
+
+void spawnTask(Scheduler *scheduler, const char *source, FILE *out, FILE *err,
+               TaskDoneFn done, void *data) {
+    Task *task = malloc(sizeof(Task));
+    if (task == NULL) exit(1);
+    initVM(&task->vm);
+    task->vm.out = out;
+    task->vm.err = err;
+    setBudget(&task->vm, scheduler->slice, PREEMPT_YIELD);
+    task->source = strdup(source);
+    task->context = NULL;
+    task->done = done;
+    task->data = data;
+
+    pthread_mutex_lock(&scheduler->lock);
+    scheduler->live++;
+    enqueue(scheduler, task);
+    pthread_mutex_unlock(&scheduler->lock);
+}
+
+void stopScheduler(Scheduler *scheduler) {
+    pthread_mutex_lock(&scheduler->lock);
+    scheduler->stopping = true;
+    pthread_cond_broadcast(&scheduler->ready);
+    pthread_mutex_unlock(&scheduler->lock);
+
+    for (int i = 0; i < scheduler->threadCount; i++) {
+        pthread_join(scheduler->threads[i], NULL);
+    }
+    pthread_cond_destroy(&scheduler->ready);
+    pthread_mutex_destroy(&scheduler->lock);
+    free(scheduler->threads);
+    free(scheduler);
+}
@@ -0,0 +1,31 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#ifndef CSCRIPTY_SCHEDULER_H
+#define CSCRIPTY_SCHEDULER_H
+
+#include <stdio.h>
+#include "common.h"
+#include "vm.h"
+
+typedef struct Scheduler Scheduler;
+
+// Called on a worker thread once a task's script has finished.
+typedef void (*TaskDoneFn)(void *data, InterpretResult result);
+
+// Starts `workers` threads that round-robin scripts from one shared run
+// queue. Each script runs for at most `slice` back-edges and calls before it is
+// suspended and put back at the tail of the queue.
+Scheduler *startScheduler(int workers, uint64_t slice);
+
+// Queues `source` to run in its own VM, writing to `out` and `err`. The
+// source is copied. `done` may be NULL.
+void spawnTask(Scheduler *scheduler, const char *source, FILE *out, FILE *err,
+               TaskDoneFn done, void *data);
+
+// Waits for every spawned task to finish, then stops the workers and frees
+// the scheduler.
+void stopScheduler(Scheduler *scheduler);
+
+#endif //CSCRIPTY_SCHEDULER_H
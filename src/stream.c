@@ -0,0 +1,152 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "stream.h"
+#include "scanner.h"
+
+void initSourceStream(SourceStream *stream, FILE *in) {
+    stream->in = in;
+    stream->capacity = STREAM_BLOCK;
+    stream->buffer = malloc(stream->capacity + 1);
+    if (stream->buffer == NULL) exit(1);
+    stream->buffer[0] = '\0';
+    stream->length = 0;
+    stream->eof = false;
+    stream->consumed = 0;
+    stream->cut = '\0';
+}
+
+void freeSourceStream(SourceStream *stream) {
+    free(stream->buffer);
+    stream->buffer = NULL;
+    stream->length = 0;
+    stream->capacity = 0;
+}
+
+static void resize(SourceStream *stream, size_t capacity) {
+    stream->capacity = capacity;
+    stream->buffer = realloc(stream->buffer, stream->capacity + 1);
+    if (stream->buffer == NULL) exit(1);
+}
+
+// Drops the declaration handed out last, which has run by now.
+static void dropConsumed(SourceStream *stream) {
+    if (stream->consumed == 0) return;
+    stream->buffer[stream->consumed] = stream->cut;
+    stream->length -= stream->consumed;
+    memmove(stream->buffer, stream->buffer + stream->consumed, stream->length + 1);
+    stream->consumed = 0;
+    // Give back what a long declaration needed.
+    if (stream->capacity > STREAM_BLOCK && stream->length < STREAM_BLOCK / 2) resize(stream, STREAM_BLOCK);
+}
+
+// Reads up to the end of the next line, or as much of it as fits in a
+// block. Stopping at lines lets a script piped in by a slow writer start
+// running as soon as its first declaration is complete.
+static void fill(SourceStream *stream) {
+    if (stream->capacity - stream->length < STREAM_BLOCK / 2) resize(stream, stream->capacity * 2);
+    char *end = stream->buffer + stream->length;
+    size_t room = stream->capacity - stream->length;
+    if (room > STREAM_BLOCK) room = STREAM_BLOCK;
+    if (fgets(end, (int) room + 1, stream->in) == NULL) {
+        *end = '\0';
+        stream->eof = true;
+        return;
+    }
+    stream->length += strlen(end);
+}
+
+static const char *handOut(SourceStream *stream, size_t length) {
+    stream->consumed = length;
+    stream->cut = stream->buffer[length];
+    stream->buffer[length] = '\0';
+    return stream->buffer;
+}
+
+// Whether a `{` after `previous` starts a map rather than a block.
+static bool startsValue(TokenType previous) {
+    switch (previous) {
+        case T_ASSIGN:
+        case T_PUTS:
+        case T_RETURN:
+        case T_PLUS:
+        case T_MINUS:
+        case T_ASTERISK:
+        case T_SLASH:
+        case T_BANG:
+        case T_EQ:
+        case T_NE:
+        case T_GT:
+        case T_GTE:
+        case T_LT:
+        case T_LTE:
+        case T_AND:
+        case T_OR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+const char *nextDeclaration(SourceStream *stream) {
+    dropConsumed(stream);
+    // A declaration ends with a `;` or the `}` of a block outside any
+    // brackets, unless an `if` in it takes an `else` next.
+    size_t scanned = 0;
+    size_t end = 0;
+    int depth = 0;
+    bool started = false;
+    bool blockOpen = false;
+    bool sawIf = false;
+    TokenType previous = T_SEMICOLON;
+    for (;;) {
+        Scanner scanner;
+        initScanner(&scanner, stream->buffer + scanned);
+        Token token = scanToken(&scanner);
+        size_t tokenEnd = scanner.current - stream->buffer;
+        // A token running up to the end of what has been read may go on in
+        // what has not.
+        if (!stream->eof && (token.type == T_EOF || tokenEnd >= stream->length)) {
+            fill(stream);
+            continue;
+        }
+        if (token.type == T_EOF) return started ? handOut(stream, stream->length) : NULL;
+        if (end != 0) {
+            if (token.type != T_ELSE) return handOut(stream, end);
+            end = 0;
+        }
+        started = true;
+        switch (token.type) {
+            case T_LPAREN:
+            case T_LBRACK:
+                depth++;
+                break;
+            case T_LBRACE:
+                if (depth == 0) blockOpen = !startsValue(previous);
+                depth++;
+                break;
+            case T_RPAREN:
+            case T_RBRACK:
+                if (depth > 0) depth--;
+                break;
+            case T_RBRACE:
+                if (depth > 0) depth--;
+                if (depth == 0 && blockOpen) end = tokenEnd;
+                break;
+            case T_SEMICOLON:
+                if (depth == 0) end = tokenEnd;
+                break;
+            case T_IF:
+                if (depth == 0) sawIf = true;
+                break;
+            default:
+                break;
+        }
+        if (end != 0 && !sawIf) return handOut(stream, end);
+        previous = token.type;
+        scanned = tokenEnd;
+    }
+}
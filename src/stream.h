@@ -0,0 +1,40 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#ifndef CSCRIPTY_STREAM_H
+#define CSCRIPTY_STREAM_H
+
+#include <stdio.h>
+#include "common.h"
+
+// The most bytes read from the input at a time, and the buffer size kept
+// between declarations.
+#define STREAM_BLOCK 65536
+
+// Reads a script from a file a block at a time and hands it out one
+// top-level declaration at a time, so only the declaration being run and
+// the input read past it are held in memory.
+typedef struct {
+    FILE *in;
+    char *buffer;
+    size_t length;
+    size_t capacity;
+    bool eof;
+    // The first `consumed` bytes of the buffer are the declaration handed
+    // out last, cut off from the rest by a NUL in place of `cut`.
+    size_t consumed;
+    char cut;
+} SourceStream;
+
+void initSourceStream(SourceStream *stream, FILE *in);
+
+// Returns the next top-level declaration as source, valid until the next
+// call, or NULL once the input is used up. Declarations are found from
+// their tokens alone, so one with syntax errors still ends somewhere and
+// the compiler reports them. Read errors end the input; check ferror().
+const char *nextDeclaration(SourceStream *stream);
+
+void freeSourceStream(SourceStream *stream);
+
+#endif //CSCRIPTY_STREAM_H
@@ -16,8 +16,8 @@ void initTable(Table *table) {
     table->entries = NULL;
 }
 
-void freeTable(Table *table) {
-    FREE_ARRAY(Entry, table->entries, table->capacity);
+void freeTable(VM *vm, Table *table) {
+    FREE_ARRAY(vm, MEM_TABLE, Entry, table->entries, table->capacity);
     initTable(table);
 }
 
@@ -39,8 +39,8 @@ static Entry *findEntry(Entry *entries, int capacity, ObjString *key) {
     }
 }
 
-static void adjustCapacity(Table *table, int capacity) {
-    Entry *entries = ALLOCATE(Entry, capacity);
+static void adjustCapacity(VM *vm, Table *table, int capacity) {
+    Entry *entries = ALLOCATE(vm, MEM_TABLE, Entry, capacity);
     for (int i = 0; i < capacity; i++) {
         entries[i].key = NULL;
         entries[i].value = NULL_VAL;
@@ -54,15 +54,15 @@ static void adjustCapacity(Table *table, int capacity) {
         dest->value = entry->value;
         table->count++;
     }
-    FREE_ARRAY(Entry, table->entries, table->capacity);
+    FREE_ARRAY(vm, MEM_TABLE, Entry, table->entries, table->capacity);
     table->entries = entries;
     table->capacity = capacity;
 }
 
-bool tableSet(Table *table, ObjString *key, Value value) {
+bool tableSet(VM *vm, Table *table, ObjString *key, Value value) {
     if (table->count + 1 > table->capacity * TABLE_MAX_LOAD) {
         int cap = GROW_CAPACITY(table->capacity);
-        adjustCapacity(table, cap);
+        adjustCapacity(vm, table, cap);
     }
     Entry *entry = findEntry(table->entries, table->capacity, key);
     bool isNewKey = entry->key == NULL;
@@ -72,11 +72,11 @@ bool tableSet(Table *table, ObjString *key, Value value) {
     return isNewKey;
 }
 
-void tableAddAll(Table *from, Table *to) {
+void tableAddAll(VM *vm, Table *from, Table *to) {
     for (int i = 0; i < from->capacity; ++i) {
         Entry *entry = &from->entries[i];
         if (entry->key != NULL) {
-            tableSet(to, entry->key, entry->value);
+            tableSet(vm, to, entry->key, entry->value);
         }
     }
 }
@@ -89,6 +89,12 @@ bool tableGet(Table *table, ObjString *key, Value *value) {
     return true;
 }
 
+Entry *tableFindEntry(Table *table, ObjString *key) {
+    if (table->count == 0) return NULL;
+    Entry *entry = findEntry(table->entries, table->capacity, key);
+    return entry->key == NULL ? NULL : entry;
+}
+
 bool tableDelete(Table *table, ObjString *key) {
     if (table->count == 0) return false;
     Entry *entry = findEntry(table->entries, table->capacity, key);
@@ -21,15 +21,19 @@ typedef struct {
 
 void initTable(Table *table);
 
-void freeTable(Table *table);
+void freeTable(VM *vm, Table *table);
 
 bool tableGet(Table *table, ObjString *key, Value *value);
 
-bool tableSet(Table *table, ObjString *key, Value value);
+// Returns the live entry for `key`, or NULL. The pointer is valid until the
+// table next grows.
+Entry *tableFindEntry(Table *table, ObjString *key);
+
+bool tableSet(VM *vm, Table *table, ObjString *key, Value value);
 
 bool tableDelete(Table *table, ObjString *key);
 
-void tableAddAll(Table *from, Table *to);
+void tableAddAll(VM *vm, Table *from, Table *to);
 
 ObjString *tableFindString(Table *table, const char *chars, int length, uint32_t hash);
 
@@ -0,0 +1,134 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "tracer.h"
+#include "debug.h"
+#include "object.h"
+#include "vm.h"
+
+#define TRACE_MAGIC "CSTRACE2"
+
+typedef struct {
+    char magic[8];
+    uint64_t recorded;
+    uint32_t count;
+    uint32_t capacity;
+} TraceHeader;
+
+void initTracer(Tracer *tracer, const char *path) {
+    tracer->path = path;
+    tracer->recorded = 0;
+}
+
+bool dumpTrace(Tracer *tracer) {
+    FILE *file = fopen(tracer->path, "wb");
+    if (file == NULL) return false;
+
+    TraceHeader header;
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.recorded = tracer->recorded;
+    header.count = tracer->recorded < TRACE_CAPACITY ? (uint32_t) tracer->recorded : TRACE_CAPACITY;
+    header.capacity = TRACE_CAPACITY;
+    fwrite(&header, sizeof(header), 1, file);
+
+    // Oldest event first.
+    uint64_t first = tracer->recorded - header.count;
+    for (uint64_t i = first; i < tracer->recorded; i++) {
+        fwrite(&tracer->events[i & (TRACE_CAPACITY - 1)], sizeof(TraceEvent), 1, file);
+    }
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
+
+static const char *tagName(uint8_t tag) {
+    switch (tag) {
+        case TRACE_EMPTY_STACK:
+            return "-";
+        case V_BOOL:
+            return "bool";
+        case V_NULL:
+            return "null";
+        case V_NUM:
+            return "num";
+        case V_INT:
+            return "int";
+        case TRACE_OBJ_TAG | O_STRING:
+            return "string";
+        case TRACE_OBJ_TAG | O_ROPE:
+            return "rope";
+        case TRACE_OBJ_TAG | O_LIST:
+            return "list";
+        case TRACE_OBJ_TAG | O_MAP:
+            return "map";
+        case TRACE_OBJ_TAG | O_ARRAY:
+            return "array";
+        case TRACE_OBJ_TAG | O_FUNCTION:
+            return "function";
+        case TRACE_OBJ_TAG | O_NATIVE:
+            return "native";
+        default:
+            return "?";
+    }
+}
+
+// The code a trace can refer to, indexed by function id.
+typedef struct {
+    ObjFunction **functions;
+    int count;
+} TracedCode;
+
+static void collectFunctions(TracedCode *code, Chunk *chunk) {
+    for (int i = 0; i < chunk->constants.count; i++) {
+        Value constant = chunk->constants.values[i];
+        if (!IS_FUNCTION(constant)) continue;
+        ObjFunction *function = AS_FUNCTION(constant);
+        if (function->id >= code->count) {
+            int count = function->id + 1;
+            code->functions = realloc(code->functions, sizeof(ObjFunction *) * count);
+            if (code->functions == NULL) exit(1);
+            memset(code->functions + code->count, 0, sizeof(ObjFunction *) * (count - code->count));
+            code->count = count;
+        }
+        code->functions[function->id] = function;
+        collectFunctions(code, &function->chunk);
+    }
+}
+
+bool decodeTrace(VM *vm, Chunk *chunk, FILE *in) {
+    TraceHeader header;
+    if (fread(&header, sizeof(header), 1, in) != 1 ||
+        memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0) {
+        fprintf(vm->err, "Not a trace file.\n");
+        return false;
+    }
+    TracedCode code = {NULL, 0};
+    collectFunctions(&code, chunk);
+
+    fprintf(vm->out, "== trace: last %u of %llu instructions ==\n", header.count,
+            (unsigned long long) header.recorded);
+    uint64_t sequence = header.recorded - header.count;
+    TraceEvent event;
+    for (uint32_t i = 0; i < header.count; i++, sequence++) {
+        if (fread(&event, sizeof(event), 1, in) != 1) {
+            fprintf(vm->err, "Truncated trace file.\n");
+            free(code.functions);
+            return false;
+        }
+        ObjFunction *function = event.function < code.count ? code.functions[event.function] : NULL;
+        Chunk *eventChunk = event.function == 0 ? chunk : function != NULL ? &function->chunk : NULL;
+        fprintf(vm->out, "%10llu depth %3u top %-6s %-12.12s ", (unsigned long long) sequence, event.depth,
+                tagName(event.tag), event.function == 0 ? "<script>" : function != NULL ? function->name->chars : "?");
+        if (eventChunk == NULL || event.offset >= (uint32_t) eventChunk->count ||
+            eventChunk->code[event.offset] != event.opcode) {
+            fprintf(vm->out, "%04u %s (does not match the script)\n", event.offset, opName(event.opcode));
+            continue;
+        }
+        disassembleInstruction(vm, eventChunk, (int) event.offset);
+    }
+    free(code.functions);
+    return true;
+}
@@ -0,0 +1,54 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+#ifndef CSCRIPTY_TRACER_H
+#define CSCRIPTY_TRACER_H
+
+#include <stdio.h>
+#include "common.h"
+#include "chunk.h"
+
+#define TRACE_CAPACITY 4096
+#define TRACE_EMPTY_STACK 0xff
+#define TRACE_OBJ_TAG 0x80
+
+// One executed instruction. `offset` is into the chunk of the function
+// with the id `function`, or of the script for 0. `tag` is the ValueType of
+// the stack top, TRACE_OBJ_TAG | ObjType for objects, or TRACE_EMPTY_STACK.
+typedef struct {
+    uint32_t offset;
+    uint16_t function;
+    uint16_t depth;
+    uint8_t opcode;
+    uint8_t tag;
+} TraceEvent;
+
+// Keeps the last TRACE_CAPACITY instructions in memory. The buffer is
+// written out on runtime errors and can be dumped at any time.
+typedef struct {
+    const char *path;
+    uint64_t recorded;
+    TraceEvent events[TRACE_CAPACITY];
+} Tracer;
+
+static inline void traceEvent(Tracer *tracer, uint16_t function, uint32_t offset, uint8_t opcode,
+                              uint16_t depth, uint8_t tag) {
+    TraceEvent *event = &tracer->events[tracer->recorded++ & (TRACE_CAPACITY - 1)];
+    event->offset = offset;
+    event->function = function;
+    event->depth = depth;
+    event->opcode = opcode;
+    event->tag = tag;
+}
+
+void initTracer(Tracer *tracer, const char *path);
+
+bool dumpTrace(Tracer *tracer);
+
+// Prints a dumped trace against `chunk`, the compiled script that produced
+// it. Events from functions are decoded against the chunks of the functions
+// found among the script's constants.
+bool decodeTrace(VM *vm, Chunk *chunk, FILE *in);
+
+#endif //CSCRIPTY_TRACER_H
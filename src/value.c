@@ -7,46 +7,68 @@
 #include "memory.h"
 #include "value.h"
 #include "object.h"
+#include "vm.h"
 
-void initValueArray(ValueArray *array) {
+void initValueArray(ValueArray *array, MemCategory category) {
     array->values = NULL;
+    array->category = category;
     array->capacity = 0;
     array->count = 0;
 }
 
-void writeValueArray(ValueArray *array, Value value) {
+void writeValueArray(VM *vm, ValueArray *array, Value value) {
     if (array->capacity < array->count + 1) {
         int oldCap = array->capacity;
         array->capacity = GROW_CAPACITY(oldCap);
-        array->values = GROW_ARRAY(Value, array->values, oldCap, array->capacity);
+        array->values = GROW_ARRAY(vm, array->category, Value, array->values, oldCap, array->capacity);
     }
     array->values[array->count] = value;
     array->count++;
 }
 
-void freeValueArray(ValueArray *array) {
-    FREE_ARRAY(Value, array->values, array->capacity);
-    initValueArray(array);
+void freeValueArray(VM *vm, ValueArray *array) {
+    FREE_ARRAY(vm, array->category, Value, array->values, array->capacity);
+    initValueArray(array, array->category);
 }
 
-void printValue(Value value) {
+char *formatInt(int64_t value, char *end) {
+    // Work on the magnitude as unsigned so INT64_MIN does not overflow.
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t) value : (uint64_t) value;
+    char *start = end;
+    do {
+        *--start = (char) ('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0) *--start = '-';
+    return start;
+}
+
+void printValue(VM *vm, Value value) {
     switch (value.type) {
         case V_BOOL:
-            printf(AS_BOOL(value) ? "true" : "false");
+            fputs(AS_BOOL(value) ? "true" : "false", vm->out);
             break;
         case V_NULL:
-            printf("null");
+            fputs("null", vm->out);
             break;
         case V_NUM:
-            printf("%g", AS_NUM(value));
+            fprintf(vm->out, "%g", AS_NUM(value));
+            break;
+        case V_INT: {
+            char buffer[20];
+            char *end = buffer + sizeof(buffer);
+            char *start = formatInt(AS_INT(value), end);
+            fwrite(start, 1, end - start, vm->out);
             break;
+        }
         case V_OBJ:
-            printObject(value);
+            printObject(vm, value);
             break;
     }
 }
 
-bool valuesEqual(Value a, Value b) {
+bool valuesEqual(VM *vm, Value a, Value b) {
+    if (IS_NUMERIC(a) && IS_NUMERIC(b) && a.type != b.type) return asDouble(a) == asDouble(b);
     if (a.type != b.type) return false;
     switch (a.type) {
         case V_BOOL:
@@ -55,9 +77,32 @@ bool valuesEqual(Value a, Value b) {
             return true;
         case V_NUM:
             return AS_NUM(a) == AS_NUM(b);
+        case V_INT:
+            return AS_INT(a) == AS_INT(b);
+        case V_OBJ:
+            if (isStringLike(a) && isStringLike(b)) {
+                return stringsEqual(asFlatString(vm, a), asFlatString(vm, b));
+            }
+            return AS_OBJ(a) == AS_OBJ(b);
+        default:
+            return false;
+    }
+}
+
+bool valuesIdentical(Value a, Value b) {
+    if (a.type != b.type) return false;
+    switch (a.type) {
+        case V_BOOL:
+            return AS_BOOL(a) == AS_BOOL(b);
+        case V_NULL:
+            return true;
+        case V_NUM:
+            return memcmp(&AS_NUM(a), &AS_NUM(b), sizeof(double)) == 0;
+        case V_INT:
+            return AS_INT(a) == AS_INT(b);
         case V_OBJ:
             return AS_OBJ(a) == AS_OBJ(b);
         default:
             return false;
     }
-}
\ No newline at end of file
+}
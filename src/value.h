@@ -15,6 +15,7 @@ typedef enum {
     V_NULL,
     V_NUM,
     V_OBJ,
+    V_INT,
 } ValueType;
 
 typedef struct {
@@ -22,6 +23,7 @@ typedef struct {
     union {
         bool boolean;
         double number;
+        int64_t integer;
         Obj *obj;
     } as;
 } Value;
@@ -30,30 +32,50 @@ typedef struct {
 #define IS_NULL(val) ((val).type == V_NULL)
 #define IS_NUM(val)  ((val).type == V_NUM)
 #define IS_OBJ(val)  ((val).type == V_OBJ)
+#define IS_INT(val)  ((val).type == V_INT)
+#define IS_NUMERIC(val) (IS_NUM(val) || IS_INT(val))
 
 #define AS_OBJ(val)    ((val).as.obj)
 #define AS_BOOL(val)   ((val).as.boolean)
 #define AS_NUM(val)    ((val).as.number)
+#define AS_INT(val)    ((val).as.integer)
 
 #define BOOL_VAL(val)    ((Value){V_BOOL, {.boolean = val}})
 #define NULL_VAL         ((Value){V_NULL, {.number = 0}})
 #define NUM_VAL(val)     ((Value){V_NUM, {.number = val}})
 #define OBJ_VAL(object)  ((Value){V_OBJ, {.obj = (Obj*)object}})
+#define INT_VAL(val)     ((Value){V_INT, {.integer = val}})
 
 typedef struct {
     int capacity;
     int count;
     Value *values;
+    MemCategory category;
 } ValueArray;
 
-bool valuesEqual(Value a, Value b);
+// Widens either numeric kind to a double. A function rather than a macro
+// because callers pass pop().
+static inline double asDouble(Value value) {
+    return IS_INT(value) ? (double) AS_INT(value) : AS_NUM(value);
+}
 
-void initValueArray(ValueArray *array);
+bool valuesEqual(VM *vm, Value a, Value b);
 
-void writeValueArray(ValueArray *array, Value value);
+// True if `a` and `b` are interchangeable as constants. Unlike
+// valuesEqual(), 1 and 1.0 or 0.0 and -0.0 differ, and objects compare by
+// identity.
+bool valuesIdentical(Value a, Value b);
 
-void freeValueArray(ValueArray *array);
+void initValueArray(ValueArray *array, MemCategory category);
 
-void printValue(Value value);
+void writeValueArray(VM *vm, ValueArray *array, Value value);
+
+void freeValueArray(VM *vm, ValueArray *array);
+
+void printValue(VM *vm, Value value);
+
+// Writes the decimal digits of `value` ending just before `end` and returns
+// where they start. The buffer needs room for 20 characters.
+char *formatInt(int64_t value, char *end);
 
 #endif //CSCRIPTY_VALUE_H
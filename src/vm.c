@@ -3,211 +3,831 @@
 //
 
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include "vm.h"
-#include "debug.h"
 #include "compiler.h"
 #include "object.h"
 #include "memory.h"
-
-VM vm;
+#include "map.h"
+#include "kernels.h"
+#include "native.h"
+#include "debug.h"
+#include "stream.h"
 
 static bool isFalsey(Value value);
 
-static void concatenate() {
-    ObjString *b = AS_STRING(pop());
-    ObjString *a = AS_STRING(pop());
+static void concatenate(VM *vm) {
+    Obj *b = AS_OBJ(pop(vm));
+    Obj *a = AS_OBJ(pop(vm));
+    push(vm, OBJ_VAL(concatStrings(vm, a, b)));
+}
+
+static void resetStack(VM *vm) {
+    vm->stackTop = vm->stack;
+}
+
+static ExecContext *allocateContext(VM *vm) {
+    ExecContext *context = ALLOCATE(vm, MEM_STACK, ExecContext, 1);
+    initChunk(&context->chunk);
+    context->frames = ALLOCATE(vm, MEM_STACK, CallFrame, FRAMES_MAX);
+    context->stack = ALLOCATE(vm, MEM_STACK, Value, STACK_MAX);
+    rewindContext(context);
+    return context;
+}
+
+static ExecContext *compileContext(VM *vm, const char *source,
+                                   bool (*compileFn)(VM *, const char *, Chunk *)) {
+    ExecContext *context = allocateContext(vm);
+    if (!compileFn(vm, source, &context->chunk)) {
+        freeContext(vm, context);
+        return NULL;
+    }
+    rewindContext(context);
+    return context;
+}
+
+void rewindContext(ExecContext *context) {
+    CallFrame *frame = &context->frames[0];
+    frame->function = NULL;
+    frame->chunk = &context->chunk;
+    frame->ip = context->chunk.code;
+    frame->slots = context->stack;
+    context->frameCount = 1;
+    context->stackTop = context->stack;
+    context->finished = false;
+}
+
+ExecContext *newContext(VM *vm, const char *source) {
+    return compileContext(vm, source, compile);
+}
 
-    int length = a->length + b->length;
-    char *chars = ALLOCATE(char, length + 1);
-    memcpy(chars, a->chars, a->length);
-    memcpy(chars + a->length, b->chars, b->length);
-    chars[length] = '\0';
-    ObjString *result = takeString(chars, length);
-    push(OBJ_VAL(result));
+ExecContext *newExpressionContext(VM *vm, const char *source) {
+    return compileContext(vm, source, compileExpression);
 }
 
-static void resetStack() {
-    vm.stackTop = vm.stack;
+void freeContext(VM *vm, ExecContext *context) {
+    if (vm->suspended == context) vm->suspended = NULL;
+    freeChunk(vm, &context->chunk);
+    FREE_ARRAY(vm, MEM_STACK, CallFrame, context->frames, FRAMES_MAX);
+    FREE_ARRAY(vm, MEM_STACK, Value, context->stack, STACK_MAX);
+    FREE(vm, MEM_STACK, ExecContext, context);
 }
 
-static void runtimeError(const char *format, ...) {
+#define ERROR_TRACE_FRAMES 16
+
+void runtimeError(VM *vm, const char *format, ...) {
     va_list args;
             va_start(args, format);
-    vfprintf(stderr, format, args);
+    vfprintf(vm->err, format, args);
             va_end(args);
-    fputs("\n", stderr);
+    fputs("\n", vm->err);
+
+    // Innermost call first. Each frame's ip is just past the instruction
+    // it was running. Deep recursion is cut down to its innermost frames
+    // and the script's own.
+    vm->frame->ip = vm->ip;
+    CallFrame *frames = vm->context->frames;
+    for (CallFrame *frame = vm->frame; frame >= frames; frame--) {
+        if (vm->frame - frame == ERROR_TRACE_FRAMES && frame - frames > 1) {
+            fprintf(vm->err, "[%d more calls]\n", (int) (frame - frames));
+            frame = frames + 1;
+            continue;
+        }
+        int line = frame->chunk->lines[frame->ip - frame->chunk->code - 1];
+        if (frame->function == NULL) {
+            fprintf(vm->err, "[line %d] in code\n", line);
+        } else {
+            fprintf(vm->err, "[line %d] in %s()\n", line, frame->function->name->chars);
+        }
+    }
+    if (vm->tracer != NULL && !dumpTrace(vm->tracer)) {
+        fprintf(vm->err, "Could not write trace '%s'.\n", vm->tracer->path);
+    }
+    resetStack(vm);
+}
+
+void initVM(VM *vm) {
+    memset(&vm->memory, 0, sizeof(MemStats));
+    vm->stack = NULL;
+    vm->stackTop = NULL;
+    vm->context = NULL;
+    vm->suspended = NULL;
+    vm->objects = NULL;
+    vm->out = stdout;
+    vm->err = stderr;
+    vm->profiler = NULL;
+    vm->tracer = NULL;
+    vm->chunk = NULL;
+    vm->ip = NULL;
+    vm->slots = NULL;
+    vm->frame = NULL;
+    vm->budget = 0;
+    vm->budgetLeft = UINT64_MAX;
+    vm->preempt = PREEMPT_ABORT;
+    atomic_init(&vm->interrupted, false);
+    initTable(&vm->globals);
+    defineStandardNatives(vm);
+}
+
+void freeVM(VM *vm) {
+    if (vm->suspended != NULL) freeContext(vm, vm->suspended);
+    freeTable(vm, &vm->globals);
+    freeObjects(vm);
+}
+
+static Value peek(VM *vm, int distance);
+
+static void traceInstruction(VM *vm) {
+    uint8_t tag = TRACE_EMPTY_STACK;
+    if (vm->stackTop > vm->stack) {
+        Value top = vm->stackTop[-1];
+        tag = IS_OBJ(top) ? (uint8_t) (TRACE_OBJ_TAG | OBJ_TYPE(top)) : (uint8_t) top.type;
+    }
+    ObjFunction *function = vm->frame->function;
+    traceEvent(vm->tracer, function == NULL ? 0 : function->id, (uint32_t) (vm->ip - vm->chunk->code), *vm->ip,
+               (uint16_t) (vm->stackTop - vm->stack), tag);
+}
+
+void setBudget(VM *vm, uint64_t backEdges, PreemptPolicy policy) {
+    vm->budget = backEdges;
+    vm->budgetLeft = backEdges == 0 ? UINT64_MAX : backEdges;
+    vm->preempt = policy;
+}
+
+void interruptVM(VM *vm) {
+    atomic_store_explicit(&vm->interrupted, true, memory_order_relaxed);
+}
+
+static inline bool budgetSpent(VM *vm) {
+    return --vm->budgetLeft == 0 || atomic_load_explicit(&vm->interrupted, memory_order_relaxed);
+}
+
+// Called from OP_LOOP or a call once budgetSpent() says so. Returns OK to
+// keep running.
+static InterpretResult preempt(VM *vm) {
+    bool interrupted = atomic_exchange_explicit(&vm->interrupted, false, memory_order_relaxed);
+    vm->budgetLeft = vm->budget == 0 ? UINT64_MAX : vm->budget;
+    if (!interrupted && vm->budget == 0) return OK;
+    if (vm->preempt == PREEMPT_YIELD) return SUSPENDED;
+    runtimeError(vm, interrupted ? "Script interrupted." : "Budget of %llu back-edges exhausted.",
+                 (unsigned long long) vm->budget);
+    return ABORTED;
+}
+
+// Reports a runtime error unless `index` is a whole number below `length`.
+static bool checkIndex(VM *vm, Value index, int length, int *slot) {
+    int64_t i;
+    if (IS_INT(index)) {
+        i = AS_INT(index);
+    } else if (IS_NUM(index) && AS_NUM(index) == (int64_t) AS_NUM(index)) {
+        i = (int64_t) AS_NUM(index);
+    } else {
+        runtimeError(vm, "Index must be an integer.");
+        return false;
+    }
+    if (i < 0 || i >= length) {
+        runtimeError(vm, "Index %lld out of bounds for length %d.", (long long) i, length);
+        return false;
+    }
+    *slot = (int) i;
+    return true;
+}
+
+// Reports a runtime error unless the receiver of `method`, and its argument
+// if `operands` is 2, are float64 arrays of the same length.
+static bool checkArrays(VM *vm, int operands, const char *method) {
+    if (!IS_ARRAY(peek(vm, operands - 1))) {
+        runtimeError(vm, "Only float64 arrays have `%s`.", method);
+        return false;
+    }
+    if (operands == 1) return true;
+    if (!IS_ARRAY(peek(vm, 0))) {
+        runtimeError(vm, "`%s` expects a float64 array.", method);
+        return false;
+    }
+    int a = AS_ARRAY(peek(vm, 1))->count;
+    int b = AS_ARRAY(peek(vm, 0))->count;
+    if (a != b) {
+        runtimeError(vm, "`%s` needs arrays of the same length, not %d and %d.", method, a, b);
+        return false;
+    }
+    return true;
+}
+
+static void loadFrame(VM *vm, CallFrame *frame) {
+    vm->frame = frame;
+    vm->chunk = frame->chunk;
+    vm->ip = frame->ip;
+    vm->slots = frame->slots;
+}
+
+// Calls a fast native on the `argCount` numbers at `args`, straight from
+// the stack slots into C arguments.
+static inline double callFast(ObjNative *native, int argCount, Value *args) {
+    switch (argCount) {
+        case 1:
+            return native->fast.one(asDouble(args[0]));
+        case 2:
+            return native->fast.two(asDouble(args[0]), asDouble(args[1]));
+        default:
+            return native->fast.three(asDouble(args[0]), asDouble(args[1]), asDouble(args[2]));
+    }
+}
+
+// Runs a native in place of the callee and its arguments. Natives push no
+// frame, so a native in tail position simply falls through to OP_RETURN.
+static bool callNative(VM *vm, ObjNative *native, int argCount) {
+    if (native->arity != -1 && native->arity != argCount) {
+        runtimeError(vm, "`%s` expects %d arguments but got %d.", native->name->chars, native->arity, argCount);
+        return false;
+    }
+    Value *args = vm->stackTop - argCount;
+    Value result;
+    if (native->generic != NULL) {
+        if (!native->generic(vm, argCount, args, &result)) return false;
+    } else {
+        for (int i = 0; i < argCount; i++) {
+            if (!IS_NUMERIC(args[i])) {
+                runtimeError(vm, "`%s` expects numbers.", native->name->chars);
+                return false;
+            }
+        }
+        result = NUM_VAL(callFast(native, argCount, args));
+    }
+    vm->stackTop -= argCount + 1;
+    push(vm, result);
+    return true;
+}
+
+// Reports a runtime error unless `callee` is a function taking `argCount`
+// arguments.
+static bool checkCall(VM *vm, Value callee, int argCount) {
+    if (!IS_FUNCTION(callee)) {
+        runtimeError(vm, "Only functions and natives can be called.");
+        return false;
+    }
+    if (AS_FUNCTION(callee)->arity != argCount) {
+        runtimeError(vm, "`%s` expects %d arguments but got %d.", AS_FUNCTION(callee)->name->chars,
+                     AS_FUNCTION(callee)->arity, argCount);
+        return false;
+    }
+    return true;
+}
+
+// Pushes a frame for the function below the top `argCount` values. The
+// function and its arguments stay where they are and become slots 0 to
+// argCount of the new frame.
+static bool call(VM *vm, int argCount) {
+    Value callee = peek(vm, argCount);
+    if (!checkCall(vm, callee, argCount)) return false;
+    // A frame may need up to UINT8_COUNT slots for its locals.
+    if (vm->frame == &vm->context->frames[FRAMES_MAX - 1] ||
+        vm->stackTop + UINT8_COUNT > vm->stack + STACK_MAX) {
+        runtimeError(vm, "Stack overflow.");
+        return false;
+    }
+    vm->frame->ip = vm->ip;
+    ObjFunction *function = AS_FUNCTION(callee);
+    CallFrame *frame = vm->frame + 1;
+    frame->function = function;
+    frame->chunk = &function->chunk;
+    frame->ip = function->chunk.code;
+    frame->slots = vm->stackTop - argCount - 1;
+    loadFrame(vm, frame);
+    return true;
+}
 
-    size_t instruction = vm.ip - vm.chunk->code - 1;
-    int line = vm.chunk->lines[instruction];
-    fprintf(stderr, "[line %d] in code\n", line);
-    resetStack();
+// Replaces the running function's frame with a call whose result would
+// only be returned, so tail recursion runs in constant stack.
+static bool tailCall(VM *vm, int argCount) {
+    Value *callee = vm->stackTop - argCount - 1;
+    if (!checkCall(vm, *callee, argCount)) return false;
+    memmove(vm->slots, callee, sizeof(Value) * (argCount + 1));
+    vm->stackTop = vm->slots + argCount + 1;
+    ObjFunction *function = AS_FUNCTION(vm->slots[0]);
+    vm->frame->function = function;
+    vm->frame->chunk = &function->chunk;
+    vm->frame->ip = function->chunk.code;
+    loadFrame(vm, vm->frame);
+    return true;
 }
 
-void initVM() {
-    resetStack();
-    vm.objects = NULL;
-    initTable(&vm.strings);
-    initTable(&vm.globals);
+static bool checkKey(VM *vm, Value key) {
+    if (IS_NULL(key)) {
+        runtimeError(vm, "Map keys cannot be null.");
+        return false;
+    }
+    return true;
 }
 
-void freeVM() {
-    freeTable(&vm.strings);
-    freeTable(&vm.globals);
-    freeObjects();
+#ifdef DEBUG_ASSERT_TYPES
+// A compiler bug, not a script error, so it stops the process.
+static void assertNumeric(VM *vm, int operands) {
+    for (int i = 0; i < operands; i++) {
+        if (!IS_NUMERIC(vm->stackTop[-1 - i])) {
+            uint8_t instruction = vm->ip[-1];
+            fprintf(vm->err, "Type assertion failed: %s at offset %ld, line %d, has a non-numeric operand.\n",
+                    opName(instruction), (long) (vm->ip - vm->chunk->code - 1),
+                    vm->chunk->lines[vm->ip - vm->chunk->code - 1]);
+            abort();
+        }
+    }
 }
 
-static Value peek(int distance);
+#define ASSERT_NUMERIC(operands) assertNumeric(vm, operands)
+#else
+#define ASSERT_NUMERIC(operands) ((void) 0)
+#endif
 
-static InterpretResult run() {
-#define READ_BYTE() (*vm.ip++)
-#define READ_CONSTANT() (vm.chunk->constants.values[READ_BYTE()])
-#define READ_SHORT() (vm.ip += 2, (uint16_t)((vm.ip[-2] << 8) | vm.ip[-1]))
+static InterpretResult run(VM *vm) {
+#define READ_BYTE() (*vm->ip++)
+#define READ_CONSTANT() (vm->chunk->constants.values[READ_BYTE()])
+#define READ_SHORT() (vm->ip += 2, (uint16_t)((vm->ip[-2] << 8) | vm->ip[-1]))
 #define READ_STRING() AS_STRING(READ_CONSTANT())
-#define BINARY_OP(valueType, op)                      \
-    do {                                              \
-        if(!IS_NUM(peek(0)) || !IS_NUM(peek(1))) {    \
-            runtimeError("Operand must be a number"); \
-            return RUNTIME_ERROR;                     \
-        }                                             \
-        double b = AS_NUM(pop());                     \
-        double a = AS_NUM(pop());                     \
-        push(valueType(a op b));                      \
+#define BINARY_OP(valueType, op)                                    \
+    do {                                                            \
+        if(!IS_NUMERIC(peek(vm, 0)) || !IS_NUMERIC(peek(vm, 1))) {  \
+            runtimeError(vm, "Operand must be a number");           \
+            return RUNTIME_ERROR;                                   \
+        }                                                           \
+        double b = asDouble(pop(vm));                               \
+        double a = asDouble(pop(vm));                               \
+        push(vm, valueType(a op b));                                \
+    } while(false)
+// Two integers stay integers unless the result overflows, in which case
+// it is redone in double precision like any mixed operation.
+#define INT_OP(op, overflows)                                       \
+    do {                                                            \
+        if (IS_INT(peek(vm, 0)) && IS_INT(peek(vm, 1))) {           \
+            int64_t b = AS_INT(vm->stackTop[-1]);                   \
+            int64_t a = AS_INT(vm->stackTop[-2]);                   \
+            int64_t result;                                         \
+            vm->stackTop--;                                         \
+            vm->stackTop[-1] = overflows(a, b, &result)             \
+                ? NUM_VAL((double) a op (double) b)                 \
+                : INT_VAL(result);                                  \
+            break;                                                  \
+        }                                                           \
+        BINARY_OP(NUM_VAL, op);                                     \
+    } while(false)
+// The unchecked forms: both operands are known to be numbers, so only the
+// int/double split remains.
+#define INT_OP_NN(op, overflows)                                    \
+    do {                                                            \
+        ASSERT_NUMERIC(2);                                          \
+        Value vb = vm->stackTop[-1];                                \
+        Value va = vm->stackTop[-2];                                \
+        vm->stackTop--;                                             \
+        int64_t result;                                             \
+        if (IS_INT(va) && IS_INT(vb) &&                             \
+            !overflows(AS_INT(va), AS_INT(vb), &result)) {          \
+            vm->stackTop[-1] = INT_VAL(result);                     \
+        } else {                                                    \
+            vm->stackTop[-1] = NUM_VAL(asDouble(va) op asDouble(vb)); \
+        }                                                           \
+    } while(false)
+#define COMPARE_OP_NN(op)                                           \
+    do {                                                            \
+        ASSERT_NUMERIC(2);                                          \
+        Value vb = vm->stackTop[-1];                                \
+        Value va = vm->stackTop[-2];                                \
+        vm->stackTop--;                                             \
+        vm->stackTop[-1] = BOOL_VAL(IS_INT(va) && IS_INT(vb)        \
+            ? AS_INT(va) op AS_INT(vb)                              \
+            : asDouble(va) op asDouble(vb));                        \
+    } while(false)
+#define COMPARE_OP(op)                                              \
+    do {                                                            \
+        if (IS_INT(peek(vm, 0)) && IS_INT(peek(vm, 1))) {           \
+            bool result = AS_INT(vm->stackTop[-2]) op AS_INT(vm->stackTop[-1]); \
+            vm->stackTop--;                                         \
+            vm->stackTop[-1] = BOOL_VAL(result);                    \
+            break;                                                  \
+        }                                                           \
+        BINARY_OP(BOOL_VAL, op);                                    \
     } while(false)
 
     for (;;) {
-#ifdef DEBUG_TRACE_EXECUTION
-        printf("          ");
-        for (Value *slot = vm.stack; slot < vm.stackTop; slot++) {
-            printf("[ ");
-            printValue(*slot);
-            printf(" ]");
+        if (vm->tracer != NULL) traceInstruction(vm);
+        if (vm->profiler != NULL) {
+            profileInstruction(vm->profiler, *vm->ip, vm->chunk->lines[vm->ip - vm->chunk->code]);
         }
-        printf("\n");
-        disassembleInstruction(vm.chunk, (int) (vm.ip - vm.chunk->code));
-#endif
         uint8_t instruction;
         switch (instruction = READ_BYTE()) {
             case OP_CONSTANT: {
                 Value constant = READ_CONSTANT();
-                push(constant);
+                push(vm, constant);
                 break;
             }
             case OP_GREATER:
-                BINARY_OP(BOOL_VAL, >);
+                COMPARE_OP(>);
                 break;
             case OP_LESS:
-                BINARY_OP(BOOL_VAL, <);
+                COMPARE_OP(<);
                 break;
             case OP_ADD: {
-                if (IS_STRING(peek(0)) && IS_STRING(peek(1))) {
-                    concatenate();
-                } else if (IS_NUM(peek(0)) && IS_NUM(peek(1))) {
-                    double b = AS_NUM(pop());
-                    double a = AS_NUM(pop());
-                    push(NUM_VAL(a + b));
+                if (IS_INT(peek(vm, 0)) && IS_INT(peek(vm, 1))) {
+                    INT_OP(+, __builtin_add_overflow);
+                } else if (isStringLike(peek(vm, 0)) && isStringLike(peek(vm, 1))) {
+                    concatenate(vm);
+                } else if (IS_NUMERIC(peek(vm, 0)) && IS_NUMERIC(peek(vm, 1))) {
+                    double b = asDouble(pop(vm));
+                    double a = asDouble(pop(vm));
+                    push(vm, NUM_VAL(a + b));
                 } else {
-                    runtimeError("Operand type mismatch.");
+                    runtimeError(vm, "Operand type mismatch.");
                     return RUNTIME_ERROR;
                 }
                 break;
             }
             case OP_SUB:
-                BINARY_OP(NUM_VAL, -);
+                INT_OP(-, __builtin_sub_overflow);
                 break;
             case OP_MUL:
-                BINARY_OP(NUM_VAL, *);
+                INT_OP(*, __builtin_mul_overflow);
                 break;
             case OP_DIV:
                 BINARY_OP(NUM_VAL, /);
                 break;
             case OP_NOT:
-                push(BOOL_VAL(isFalsey(pop())));
+                push(vm, BOOL_VAL(isFalsey(pop(vm))));
                 break;
             case OP_NULL:
-                push(NULL_VAL);
+                push(vm, NULL_VAL);
                 break;
             case OP_TRUE:
-                push(BOOL_VAL(true));
+                push(vm, BOOL_VAL(true));
                 break;
             case OP_FALSE:
-                push(BOOL_VAL(false));
+                push(vm, BOOL_VAL(false));
                 break;
             case OP_POP:
-                pop();
+                pop(vm);
                 break;
             case OP_GET_LOCAL: {
                 uint8_t slot = READ_BYTE();
-                push(vm.stack[slot]);
+                push(vm, vm->slots[slot]);
                 break;
             }
             case OP_SET_LOCAL: {
                 uint8_t slot = READ_BYTE();
-                vm.stack[slot] = peek(0);
+                vm->slots[slot] = peek(vm, 0);
                 break;
             }
             case OP_GET_GLOBAL: {
                 ObjString *name = READ_STRING();
                 Value value;
-                if (!tableGet(&vm.globals, name, &value)) {
-                    runtimeError("Undefined variable `%s`", name->chars);
+                if (!tableGet(&vm->globals, name, &value)) {
+                    runtimeError(vm, "Undefined variable `%s`", name->chars);
                     return RUNTIME_ERROR;
                 }
-                push(value);
+                push(vm, value);
                 break;
             }
             case OP_DEFINE_GLOBAL: {
                 ObjString *name = READ_STRING();
-                tableSet(&vm.globals, name, peek(0));
-                pop();
+                tableSet(vm, &vm->globals, name, peek(vm, 0));
+                pop(vm);
                 break;
             }
             case OP_SET_GLOBAL: {
                 ObjString *name = READ_STRING();
-                if (tableSet(&vm.globals, name, peek(0))) {
-                    tableDelete(&vm.globals, name);
-                    runtimeError("Undefined variable `%s`", name->chars);
+                if (tableSet(vm, &vm->globals, name, peek(vm, 0))) {
+                    tableDelete(&vm->globals, name);
+                    runtimeError(vm, "Undefined variable `%s`", name->chars);
                     return RUNTIME_ERROR;
                 }
                 break;
             }
             case OP_EQUAL: {
-                Value b = pop();
-                Value a = pop();
-                push(BOOL_VAL(valuesEqual(a, b)));
+                Value b = pop(vm);
+                Value a = pop(vm);
+                push(vm, BOOL_VAL(valuesEqual(vm, a, b)));
                 break;
             }
             case OP_NEGATE: {
-                if (!IS_NUM(peek(0))) {
-                    runtimeError("Operand must be a number");
+                Value operand = peek(vm, 0);
+                if (IS_INT(operand) && AS_INT(operand) != INT64_MIN) {
+                    vm->stackTop[-1] = INT_VAL(-AS_INT(operand));
+                    break;
+                }
+                if (!IS_NUMERIC(operand)) {
+                    runtimeError(vm, "Operand must be a number");
                     return RUNTIME_ERROR;
                 }
-                push(NUM_VAL(-AS_NUM(pop())));
+                push(vm, NUM_VAL(-asDouble(pop(vm))));
                 break;
             }
             case OP_PUTS: {
-                printValue(pop());
-                printf("\n");
+                printValue(vm, pop(vm));
+                fputc('\n', vm->out);
                 break;
             }
             case OP_JUMP: {
                 uint16_t offset = READ_SHORT();
-                vm.ip += offset;
+                vm->ip += offset;
                 break;
             }
             case OP_JUMP_IF_FALSE: {
                 uint16_t offset = READ_SHORT();
-                if (isFalsey(peek(0))) vm.ip += offset;
+                if (isFalsey(peek(vm, 0))) vm->ip += offset;
                 break;
             }
             case OP_LOOP: {
                 uint16_t offset = READ_SHORT();
-                vm.ip -= offset;
+                if (budgetSpent(vm)) {
+                    // Checked before jumping so an abort reports the loop's
+                    // line; a suspended script resumes at the loop head.
+                    InterpretResult result = preempt(vm);
+                    if (result == ABORTED) return ABORTED;
+                    vm->ip -= offset;
+                    if (result == SUSPENDED) return SUSPENDED;
+                    break;
+                }
+                vm->ip -= offset;
+                break;
+            }
+            case OP_BUILD_LIST: {
+                uint8_t count = READ_BYTE();
+                ObjList *list = newList(vm);
+                for (int i = count; i > 0; i--) {
+                    writeValueArray(vm, &list->items, vm->stackTop[-i]);
+                }
+                vm->stackTop -= count;
+                push(vm, OBJ_VAL(list));
+                break;
+            }
+            case OP_INDEX_GET: {
+                if (IS_MAP(peek(vm, 1))) {
+                    // A missing key reads as null, so counters can start
+                    // with `m[k] or 0`.
+                    Value value;
+                    if (!mapGet(vm, AS_MAP(peek(vm, 1)), peek(vm, 0), &value)) value = NULL_VAL;
+                    vm->stackTop -= 2;
+                    push(vm, value);
+                    break;
+                }
+                if (IS_ARRAY(peek(vm, 1))) {
+                    ObjArray *array = AS_ARRAY(peek(vm, 1));
+                    int slot;
+                    if (!checkIndex(vm, peek(vm, 0), array->count, &slot)) return RUNTIME_ERROR;
+                    vm->stackTop -= 2;
+                    push(vm, NUM_VAL(array->values[slot]));
+                    break;
+                }
+                if (!IS_LIST(peek(vm, 1))) {
+                    runtimeError(vm, "Only lists, maps and arrays can be indexed.");
+                    return RUNTIME_ERROR;
+                }
+                ObjList *list = AS_LIST(peek(vm, 1));
+                int slot;
+                if (!checkIndex(vm, peek(vm, 0), list->items.count, &slot)) return RUNTIME_ERROR;
+                vm->stackTop -= 2;
+                push(vm, list->items.values[slot]);
+                break;
+            }
+            case OP_INDEX_SET: {
+                if (IS_MAP(peek(vm, 2))) {
+                    if (!checkKey(vm, peek(vm, 1))) return RUNTIME_ERROR;
+                    Value value = pop(vm);
+                    mapSet(vm, AS_MAP(peek(vm, 1)), peek(vm, 0), value);
+                    vm->stackTop -= 2;
+                    push(vm, value);
+                    break;
+                }
+                if (IS_ARRAY(peek(vm, 2))) {
+                    ObjArray *array = AS_ARRAY(peek(vm, 2));
+                    int slot;
+                    if (!checkIndex(vm, peek(vm, 1), array->count, &slot)) return RUNTIME_ERROR;
+                    if (!IS_NUMERIC(peek(vm, 0))) {
+                        runtimeError(vm, "float64 arrays only hold numbers.");
+                        return RUNTIME_ERROR;
+                    }
+                    Value value = pop(vm);
+                    array->values[slot] = asDouble(value);
+                    vm->stackTop -= 2;
+                    push(vm, value);
+                    break;
+                }
+                if (!IS_LIST(peek(vm, 2))) {
+                    runtimeError(vm, "Only lists, maps and arrays can be indexed.");
+                    return RUNTIME_ERROR;
+                }
+                ObjList *list = AS_LIST(peek(vm, 2));
+                int slot;
+                if (!checkIndex(vm, peek(vm, 1), list->items.count, &slot)) return RUNTIME_ERROR;
+                Value value = pop(vm);
+                list->items.values[slot] = value;
+                vm->stackTop -= 2;
+                push(vm, value);
+                break;
+            }
+            case OP_LENGTH: {
+                Value target = pop(vm);
+                if (IS_LIST(target)) {
+                    push(vm, INT_VAL(AS_LIST(target)->items.count));
+                } else if (IS_MAP(target)) {
+                    push(vm, INT_VAL(AS_MAP(target)->live));
+                } else if (IS_ARRAY(target)) {
+                    push(vm, INT_VAL(AS_ARRAY(target)->count));
+                } else if (IS_STRING(target)) {
+                    push(vm, INT_VAL(AS_STRING(target)->length));
+                } else if (IS_ROPE(target)) {
+                    push(vm, INT_VAL(AS_ROPE(target)->length));
+                } else {
+                    runtimeError(vm, "Only lists, maps, arrays and strings have a length.");
+                    return RUNTIME_ERROR;
+                }
+                break;
+            }
+            case OP_APPEND: {
+                if (!IS_LIST(peek(vm, 1))) {
+                    runtimeError(vm, "Only lists can be appended to.");
+                    return RUNTIME_ERROR;
+                }
+                Value value = pop(vm);
+                writeValueArray(vm, &AS_LIST(pop(vm))->items, value);
+                push(vm, NULL_VAL);
+                break;
+            }
+            case OP_BUILD_MAP: {
+                uint8_t count = READ_BYTE();
+                ObjMap *map = newMap(vm);
+                for (int i = count * 2; i > 0; i -= 2) {
+                    if (!checkKey(vm, vm->stackTop[-i])) return RUNTIME_ERROR;
+                    mapSet(vm, map, vm->stackTop[-i], vm->stackTop[-i + 1]);
+                }
+                vm->stackTop -= count * 2;
+                push(vm, OBJ_VAL(map));
+                break;
+            }
+            case OP_HAS:
+            case OP_REMOVE: {
+                if (!IS_MAP(peek(vm, 1))) {
+                    runtimeError(vm, instruction == OP_HAS ? "Only maps have `has`." : "Only maps have `remove`.");
+                    return RUNTIME_ERROR;
+                }
+                Value key = pop(vm);
+                ObjMap *map = AS_MAP(pop(vm));
+                Value value;
+                bool found = instruction == OP_HAS ? mapGet(vm, map, key, &value) : mapDelete(vm, map, key);
+                push(vm, BOOL_VAL(found));
+                break;
+            }
+            case OP_FLOAT64: {
+                Value source = peek(vm, 0);
+                ObjArray *array;
+                if (IS_ARRAY(source)) {
+                    array = newFloat64Array(vm, AS_ARRAY(source)->count);
+                    memcpy(array->values, AS_ARRAY(source)->values, sizeof(double) * array->count);
+                } else if (IS_LIST(source)) {
+                    ValueArray *items = &AS_LIST(source)->items;
+                    for (int i = 0; i < items->count; i++) {
+                        if (!IS_NUMERIC(items->values[i])) {
+                            runtimeError(vm, "float64 arrays only hold numbers, element %d is not one.", i);
+                            return RUNTIME_ERROR;
+                        }
+                    }
+                    array = newFloat64Array(vm, items->count);
+                    for (int i = 0; i < items->count; i++) {
+                        array->values[i] = asDouble(items->values[i]);
+                    }
+                } else {
+                    runtimeError(vm, "Only lists and arrays have `float64`.");
+                    return RUNTIME_ERROR;
+                }
+                vm->stackTop[-1] = OBJ_VAL(array);
+                break;
+            }
+            case OP_SUM:
+            case OP_MIN:
+            case OP_MAX: {
+                const char *method = instruction == OP_SUM ? "sum" : instruction == OP_MIN ? "min" : "max";
+                if (!checkArrays(vm, 1, method)) return RUNTIME_ERROR;
+                ObjArray *array = AS_ARRAY(pop(vm));
+                if (instruction == OP_SUM) {
+                    push(vm, NUM_VAL(sumFloat64(array->values, array->count)));
+                } else if (array->count == 0) {
+                    // Like a missing map key, an empty array has no extreme.
+                    push(vm, NULL_VAL);
+                } else if (instruction == OP_MIN) {
+                    push(vm, NUM_VAL(minFloat64(array->values, array->count)));
+                } else {
+                    push(vm, NUM_VAL(maxFloat64(array->values, array->count)));
+                }
+                break;
+            }
+            case OP_DOT: {
+                if (!checkArrays(vm, 2, "dot")) return RUNTIME_ERROR;
+                ObjArray *b = AS_ARRAY(pop(vm));
+                ObjArray *a = AS_ARRAY(pop(vm));
+                push(vm, NUM_VAL(dotFloat64(a->values, b->values, a->count)));
+                break;
+            }
+            case OP_SCALE: {
+                if (!IS_ARRAY(peek(vm, 1))) {
+                    runtimeError(vm, "Only float64 arrays have `scale`.");
+                    return RUNTIME_ERROR;
+                }
+                if (!IS_NUMERIC(peek(vm, 0))) {
+                    runtimeError(vm, "`scale` expects a number.");
+                    return RUNTIME_ERROR;
+                }
+                ObjArray *source = AS_ARRAY(peek(vm, 1));
+                ObjArray *array = newFloat64Array(vm, source->count);
+                scaleFloat64(array->values, source->values, asDouble(peek(vm, 0)), source->count);
+                vm->stackTop -= 2;
+                push(vm, OBJ_VAL(array));
+                break;
+            }
+            case OP_ARRAY_ADD:
+            case OP_ARRAY_MUL: {
+                if (!checkArrays(vm, 2, instruction == OP_ARRAY_ADD ? "add" : "mul")) return RUNTIME_ERROR;
+                ObjArray *a = AS_ARRAY(peek(vm, 1));
+                ObjArray *b = AS_ARRAY(peek(vm, 0));
+                ObjArray *array = newFloat64Array(vm, a->count);
+                if (instruction == OP_ARRAY_ADD) {
+                    addFloat64(array->values, a->values, b->values, a->count);
+                } else {
+                    mulFloat64(array->values, a->values, b->values, a->count);
+                }
+                vm->stackTop -= 2;
+                push(vm, OBJ_VAL(array));
+                break;
+            }
+            case OP_ADD_NN:
+                INT_OP_NN(+, __builtin_add_overflow);
+                break;
+            case OP_SUB_NN:
+                INT_OP_NN(-, __builtin_sub_overflow);
+                break;
+            case OP_MUL_NN:
+                INT_OP_NN(*, __builtin_mul_overflow);
+                break;
+            case OP_DIV_NN: {
+                ASSERT_NUMERIC(2);
+                double b = asDouble(vm->stackTop[-1]);
+                double a = asDouble(vm->stackTop[-2]);
+                vm->stackTop--;
+                vm->stackTop[-1] = NUM_VAL(a / b);
+                break;
+            }
+            case OP_LESS_NN:
+                COMPARE_OP_NN(<);
+                break;
+            case OP_GREATER_NN:
+                COMPARE_OP_NN(>);
+                break;
+            case OP_NEGATE_NN: {
+                ASSERT_NUMERIC(1);
+                Value operand = vm->stackTop[-1];
+                vm->stackTop[-1] = IS_INT(operand) && AS_INT(operand) != INT64_MIN
+                                   ? INT_VAL(-AS_INT(operand))
+                                   : NUM_VAL(-asDouble(operand));
+                break;
+            }
+            case OP_CALL:
+            case OP_CALL_NN:
+            case OP_TAIL_CALL: {
+                uint8_t argCount = READ_BYTE();
+                if (budgetSpent(vm)) {
+                    InterpretResult result = preempt(vm);
+                    if (result == ABORTED) return ABORTED;
+                    if (result == SUSPENDED) {
+                        // Resuming retries the call.
+                        vm->ip -= 2;
+                        return SUSPENDED;
+                    }
+                }
+                Value callee = peek(vm, argCount);
+                if (instruction == OP_CALL_NN && IS_NATIVE(callee) && AS_NATIVE(callee)->generic == NULL &&
+                    AS_NATIVE(callee)->arity == argCount) {
+                    ASSERT_NUMERIC(argCount);
+                    Value *args = vm->stackTop - argCount;
+                    args[-1] = NUM_VAL(callFast(AS_NATIVE(callee), argCount, args));
+                    vm->stackTop = args;
+                    break;
+                }
+                bool called;
+                if (IS_NATIVE(callee)) {
+                    called = callNative(vm, AS_NATIVE(callee), argCount);
+                } else {
+                    called = instruction != OP_TAIL_CALL ? call(vm, argCount) : tailCall(vm, argCount);
+                }
+                if (!called) return RUNTIME_ERROR;
                 break;
             }
             case OP_RETURN: {
-                return OK;
+                // The script's own return leaves its stack alone, so an
+                // expression's value can be read off the top.
+                if (vm->frame->function == NULL) return OK;
+                Value result = pop(vm);
+                vm->stackTop = vm->slots;
+                push(vm, result);
+                loadFrame(vm, vm->frame - 1);
+                break;
             }
         }
     }
@@ -216,35 +836,104 @@ static InterpretResult run() {
 #undef READ_SHORT
 #undef READ_STRING
 #undef BINARY_OP
+#undef INT_OP
+#undef COMPARE_OP
+#undef INT_OP_NN
+#undef COMPARE_OP_NN
+}
+
+InterpretResult runContext(VM *vm, ExecContext *context) {
+    if (context->finished) return OK;
+    vm->context = context;
+    vm->stack = context->stack;
+    vm->stackTop = context->stackTop;
+    loadFrame(vm, &context->frames[context->frameCount - 1]);
+
+    InterpretResult result = run(vm);
+    if (vm->profiler != NULL) profileStop(vm->profiler);
+
+    vm->frame->ip = vm->ip;
+    context->frameCount = (int) (vm->frame - context->frames) + 1;
+    context->stackTop = vm->stackTop;
+    context->finished = result != SUSPENDED;
+    vm->context = NULL;
+    vm->frame = NULL;
+    vm->slots = NULL;
+    vm->chunk = NULL;
+    vm->stack = NULL;
+    vm->stackTop = NULL;
+    return result;
 }
 
-InterpretResult interpret(const char *source) {
-    Chunk chunk;
-    initChunk(&chunk);
-    if (!compile(source, &chunk)) {
-        freeChunk(&chunk);
-        return COMPILE_ERROR;
+static InterpretResult finish(VM *vm, ExecContext *context, InterpretResult result) {
+    if (result == SUSPENDED) {
+        vm->suspended = context;
+    } else {
+        freeContext(vm, context);
     }
+    return result;
+}
+
+InterpretResult interpret(VM *vm, const char *source) {
+    // A script still suspended from an earlier call is abandoned.
+    if (vm->suspended != NULL) freeContext(vm, vm->suspended);
+    atomic_store_explicit(&vm->interrupted, false, memory_order_relaxed);
+    vm->budgetLeft = vm->budget == 0 ? UINT64_MAX : vm->budget;
+
+    ExecContext *context = newContext(vm, source);
+    if (context == NULL) return COMPILE_ERROR;
+    return finish(vm, context, runContext(vm, context));
+}
 
-    vm.chunk = &chunk;
-    vm.ip = vm.chunk->code;
-    InterpretResult result = run();
-    freeChunk(&chunk);
+InterpretResult interpretStream(VM *vm, FILE *in) {
+    if (vm->suspended != NULL) freeContext(vm, vm->suspended);
+    atomic_store_explicit(&vm->interrupted, false, memory_order_relaxed);
+    vm->budgetLeft = vm->budget == 0 ? UINT64_MAX : vm->budget;
+
+    // Each declaration is compiled into the same context in turn, replacing
+    // the code of the one before, which has finished with it.
+    ExecContext *context = allocateContext(vm);
+    CompileState state;
+    initCompileState(&state);
+    SourceStream stream;
+    initSourceStream(&stream, in);
+    InterpretResult result = OK;
+    const char *source;
+    while (result == OK && (source = nextDeclaration(&stream)) != NULL) {
+        freeChunk(vm, &context->chunk);
+        if (!compileNext(vm, &state, source, &context->chunk)) {
+            result = COMPILE_ERROR;
+            break;
+        }
+        rewindContext(context);
+        result = runContext(vm, context);
+        if (result == SUSPENDED) result = ABORTED;
+    }
+    freeSourceStream(&stream);
+    freeCompileState(vm, &state);
+    freeContext(vm, context);
     return result;
 }
 
-void push(Value value) {
-    *vm.stackTop = value;
-    vm.stackTop++;
+InterpretResult resume(VM *vm) {
+    ExecContext *context = vm->suspended;
+    if (context == NULL) return OK;
+    vm->suspended = NULL;
+    return finish(vm, context, runContext(vm, context));
+}
+
+void push(VM *vm, Value value) {
+    *vm->stackTop = value;
+    vm->stackTop++;
 }
 
-Value pop() {
-    vm.stackTop -= 1;
-    return *vm.stackTop;
+Value pop(VM *vm) {
+    vm->stackTop -= 1;
+    return *vm->stackTop;
 }
 
-static Value peek(int distance) {
-    return vm.stackTop[-1 - distance];
+static Value peek(VM *vm, int distance) {
+    return vm->stackTop[-1 - distance];
 }
 
 static bool isFalsey(Value value) {
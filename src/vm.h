@@ -5,39 +5,139 @@
 #ifndef CSCRIPTY_VM_H
 #define CSCRIPTY_VM_H
 
+#include <stdio.h>
+#include <stdatomic.h>
 #include "chunk.h"
 #include "value.h"
 #include "table.h"
+#include "profiler.h"
+#include "tracer.h"
+#include "memory.h"
+#include "object.h"
 
-#define STACK_MAX 256
+#define FRAMES_MAX 256
+#define STACK_MAX (FRAMES_MAX * 16)
 
+// What run() does when the back-edge budget runs out or the VM is
+// interrupted: stop with an error, or suspend so resume() can continue.
+// Calls count as back-edges too, since recursion can loop forever without
+// ever reaching OP_LOOP.
+typedef enum {
+    PREEMPT_ABORT,
+    PREEMPT_YIELD
+} PreemptPolicy;
+
+// One active call. `slots` points into the value stack at the callee,
+// followed by its arguments, which the callee uses as its first locals
+// without copying. The script itself runs in frame 0, with no function and
+// its locals starting at the bottom of the stack.
 typedef struct {
+    ObjFunction *function;
     Chunk *chunk;
     uint8_t *ip;
-    Value stack[STACK_MAX];
+    Value *slots;
+} CallFrame;
+
+// Everything needed to continue a script: its code, its call frames and
+// its value stack. Contexts live on the heap so a suspended script can be
+// resumed later, on any thread, by whoever owns its VM.
+typedef struct {
+    Chunk chunk;
+    CallFrame *frames;
+    int frameCount;
+    Value *stack;
     Value *stackTop;
+    bool finished;
+} ExecContext;
+
+struct VM {
+    // Registers of the running context, loaded and saved by runContext().
+    // chunk, ip and slots belong to the innermost frame and are written
+    // back to it on every call.
+    Chunk *chunk;
+    uint8_t *ip;
+    Value *slots;
+    CallFrame *frame;
+    Value *stack;
+    Value *stackTop;
+    ExecContext *context;
+    // The context interpret() left suspended, if any.
+    ExecContext *suspended;
     Table globals;
-    Table strings;
 
     Obj *objects;
-} VM;
+    MemStats memory;
+    FILE *out;
+    FILE *err;
+    Profiler *profiler;
+    Tracer *tracer;
+
+    // Only checked at OP_LOOP and calls. budgetLeft counts down from
+    // budget, and a budget of 0 means unlimited.
+    uint64_t budget;
+    uint64_t budgetLeft;
+    PreemptPolicy preempt;
+    atomic_bool interrupted;
+};
 
 typedef enum {
     OK,
     COMPILE_ERROR,
-    RUNTIME_ERROR
+    RUNTIME_ERROR,
+    ABORTED,
+    SUSPENDED
 } InterpretResult;
 
-extern VM vm;
+void initVM(VM *vm);
+
+void freeVM(VM *vm);
+
+InterpretResult interpret(VM *vm, const char *source);
+
+// Runs a script as it is read from `in`, compiling and running each
+// top-level declaration before reading past it, so output starts before the
+// script has been read in full and its source never has to be held at once.
+// Stops at the first compile or runtime error, after the declarations
+// before it have run. A script cannot be suspended halfway through its
+// input, so one that yields is abandoned and reported as ABORTED.
+InterpretResult interpretStream(VM *vm, FILE *in);
+
+// Continues a script that interpret() or an earlier resume() left
+// SUSPENDED. Returns OK if nothing is suspended.
+InterpretResult resume(VM *vm);
+
+// Compiles `source` into a context that has not run yet. Returns NULL after
+// reporting a compile error.
+ExecContext *newContext(VM *vm, const char *source);
+
+// Like newContext() for a single expression, whose value is left on top of
+// the context's stack when it finishes.
+ExecContext *newExpressionContext(VM *vm, const char *source);
+
+// Runs `context` until it finishes or is suspended. Contexts sharing a VM
+// share its globals and must not run concurrently.
+InterpretResult runContext(VM *vm, ExecContext *context);
+
+// Rewinds `context` to the start of its chunk with an empty stack, so a
+// compiled program can run again.
+void rewindContext(ExecContext *context);
+
+void freeContext(VM *vm, ExecContext *context);
 
-void initVM();
+// Allows `backEdges` jumps back to a loop head per slice (0 for no limit) and sets
+// what happens when they run out or the VM is interrupted.
+void setBudget(VM *vm, uint64_t backEdges, PreemptPolicy policy);
 
-void freeVM();
+// Asks the running script to stop at its next back-edge or call. Safe to call
+// from another thread or a signal handler.
+void interruptVM(VM *vm);
 
-InterpretResult interpret(const char *source);
+// Reports an error and a trace of the active calls to vm->err. Natives
+// call it before returning false.
+void runtimeError(VM *vm, const char *format, ...);
 
-void push(Value value);
+void push(VM *vm, Value value);
 
-Value pop();
+Value pop(VM *vm);
 
 #endif //CSCRIPTY_VM_H
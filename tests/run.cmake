@@ -0,0 +1,22 @@
+# Runs one script test: `cmake -DCOMMAND=<program;args...> [-DINPUT=<file>]
+# -DEXPECTED=<file> [-DSTATUS=<exit status>] -P run.cmake` fails unless the
+# program, fed INPUT on stdin if given, prints exactly EXPECTED to stdout
+# and exits with STATUS (0 by default).
+if (NOT DEFINED STATUS)
+    set(STATUS 0)
+endif ()
+if (DEFINED INPUT)
+    set(INPUT_ARGS INPUT_FILE ${INPUT})
+endif ()
+execute_process(COMMAND ${COMMAND}
+        ${INPUT_ARGS}
+        OUTPUT_VARIABLE output
+        ERROR_VARIABLE errors
+        RESULT_VARIABLE result)
+file(READ ${EXPECTED} expected)
+if (NOT output STREQUAL expected)
+    message(FATAL_ERROR "Output differs from ${EXPECTED}:\n${output}\nstderr:\n${errors}")
+endif ()
+if (NOT result STREQUAL STATUS)
+    message(FATAL_ERROR "Exited with ${result} instead of ${STATUS}:\n${errors}")
+endif ()
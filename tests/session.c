@@ -0,0 +1,97 @@
+//
+// Created by aramh on 10/19/2026.
+//
+
+// Runs a test script the way the REPL runs what is typed into it: each part
+// between `// --` lines is interpreted in turn on the same VM, so a later
+// part sees the globals an earlier one left behind, however it stopped.
+//
+// Usage: scripty-session [--budget=back-edges] [--interrupt] path
+// With --interrupt, the first part is interrupted once it is running, as
+// Ctrl-C would, and is expected to loop until it is.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "vm.h"
+#include "intern.h"
+
+#define PART_MARK "// --\n"
+
+static atomic_bool partDone;
+
+// interpret() clears an interrupt that arrives before it starts, so keep
+// interrupting until the part has stopped.
+static void *interruptPart(void *arg) {
+    VM *vm = arg;
+    struct timespec pause = {0, 1000000};
+    while (!atomic_load(&partDone)) {
+        interruptVM(vm);
+        nanosleep(&pause, NULL);
+    }
+    return NULL;
+}
+
+static char *readFile(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Could not open file '%s'.\n", path);
+        exit(74);
+    }
+    fseek(file, 0L, SEEK_END);
+    size_t fileSize = ftell(file);
+    rewind(file);
+    char *buffer = malloc(fileSize + 1);
+    if (buffer == NULL) exit(1);
+    size_t bytesRead = fread(buffer, sizeof(char), fileSize, file);
+    buffer[bytesRead] = '\0';
+    fclose(file);
+    return buffer;
+}
+
+int main(int argc, const char *argv[]) {
+    uint64_t budget = 0;
+    bool interrupt = false;
+    int arg = 1;
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++) {
+        if (strncmp(argv[arg], "--budget=", 9) == 0) {
+            budget = strtoull(argv[arg] + 9, NULL, 10);
+        } else if (strcmp(argv[arg], "--interrupt") == 0) {
+            interrupt = true;
+        } else {
+            break;
+        }
+    }
+    if (argc - arg != 1) {
+        fprintf(stderr, "Usage: scripty-session [--budget=back-edges] [--interrupt] path\n");
+        return 64;
+    }
+
+    char *source = readFile(argv[arg]);
+    VM vm;
+    initVM(&vm);
+    setBudget(&vm, budget, PREEMPT_ABORT);
+    char *part = source;
+    for (int index = 0; part != NULL; index++) {
+        char *mark = strstr(part, PART_MARK);
+        if (mark != NULL) *mark = '\0';
+
+        pthread_t interrupter;
+        bool interrupting = interrupt && index == 0;
+        atomic_store(&partDone, false);
+        if (interrupting && pthread_create(&interrupter, NULL, interruptPart, &vm) != 0) exit(1);
+        interpret(&vm, part);
+        fflush(stdout);
+        atomic_store(&partDone, true);
+        if (interrupting) pthread_join(interrupter, NULL);
+
+        part = mark == NULL ? NULL : mark + strlen(PART_MARK);
+    }
+    freeVM(&vm);
+    freeSharedStrings();
+    free(source);
+    return 0;
+}